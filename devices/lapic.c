@@ -0,0 +1,154 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* See [IA32-v3a] chapter 10 "Advanced Programmable Interrupt
+   Controller (APIC)" for hardware details of the local APIC. */
+
+/* IA32_APIC_BASE model-specific register and its fields. */
+#define MSR_APIC_BASE 0x1b
+#define APIC_BASE_BSP (1 << 8)          /* This is the boot CPU. */
+#define APIC_BASE_ENABLE (1 << 11)      /* Local APIC enabled. */
+
+/* CPUID leaf 1 feature bits. */
+#define CPUID_EDX_APIC (1 << 9)         /* Local APIC present. */
+
+/* Local APIC register offsets. */
+#define LAPIC_ID 0x020                  /* ID, in bits 31:24. */
+#define LAPIC_VERSION 0x030             /* Version, in bits 7:0. */
+#define LAPIC_EOI 0x0b0                 /* End of interrupt. */
+#define LAPIC_SVR 0x0f0                 /* Spurious interrupt vector. */
+#define LAPIC_LVT_TIMER 0x320           /* Timer local vector table entry. */
+#define LAPIC_TIMER_INIT 0x380          /* Timer initial count. */
+#define LAPIC_TIMER_CURRENT 0x390       /* Timer current count. */
+#define LAPIC_TIMER_DIVIDE 0x3e0        /* Timer divide configuration. */
+
+#define SVR_ENABLE (1 << 8)             /* APIC software enable. */
+#define LVT_MASKED (1 << 16)            /* Interrupt masked. */
+#define TIMER_DIVIDE_16 0x3             /* Count at bus clock / 16. */
+
+/* Kernel virtual address of the local APIC registers, or a null
+   pointer if there is no usable local APIC. */
+static volatile uint32_t *lapic;
+
+/* The timer counted down timer_counts in timer_tsc TSC cycles
+   when lapic_timer_calibrate() measured it.  0 if uncalibrated. */
+static uint64_t timer_counts;
+static uint64_t timer_tsc;
+
+static uint32_t lapic_id (void);
+static uint32_t lapic_read (unsigned reg);
+static void lapic_write (unsigned reg, uint32_t value);
+
+/* Finds the local APIC of the boot CPU and maps its registers,
+   uncached, into the kernel address space.  Must be called after
+   paging_init(), since the registers live outside of RAM.  Its
+   users are the one-shot timer and end-of-interrupt; the other
+   CPUs, if any, are left halted. */
+void
+lapic_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t base, *pte;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPUID_EDX_APIC))
+		return;
+
+	base = read_msr (MSR_APIC_BASE);
+	if (!(base & APIC_BASE_ENABLE) || !(base & APIC_BASE_BSP))
+		return;
+	base &= ~(uint64_t) PGMASK & 0xffffffffffULL;
+
+	pte = pml4e_walk (base_pml4, (uint64_t) ptov (base), 1);
+	if (pte == NULL)
+		return;
+	*pte = base | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	invlpg ((uint64_t) ptov (base));
+	lapic = ptov (base);
+
+	printf ("Local APIC %"PRIu32", version %#"PRIx32".\n",
+			lapic_id (), lapic_read (LAPIC_VERSION) & 0xff);
+}
+
+/* Signals the end of the local APIC interrupt being handled. */
+void
+lapic_eoi (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Measures the local APIC timer's rate against TSC_CYCLES cycles
+   of the TSC, busy-waiting that long, and leaves the timer ready
+   to raise LAPIC_TIMER_VEC once per lapic_timer_oneshot().  Does
+   nothing if there is no local APIC. */
+void
+lapic_timer_calibrate (uint64_t tsc_cycles) {
+	uint64_t start;
+
+	if (lapic == NULL || tsc_cycles == 0)
+		return;
+
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	lapic_write (LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_INIT, UINT32_MAX);
+	start = rdtsc ();
+	while (rdtsc () - start < tsc_cycles)
+		asm volatile ("pause");
+	timer_counts = UINT32_MAX - lapic_read (LAPIC_TIMER_CURRENT);
+	timer_tsc = tsc_cycles;
+	lapic_write (LAPIC_TIMER_INIT, 0);
+
+	/* One-shot mode, unmasked. */
+	lapic_write (LAPIC_LVT_TIMER, LAPIC_TIMER_VEC);
+}
+
+/* Returns true if lapic_timer_oneshot() may be used. */
+bool
+lapic_timer_ready (void) {
+	return timer_counts != 0;
+}
+
+/* Arms the local APIC timer to interrupt once, about TSC_CYCLES
+   TSC cycles from now, replacing any earlier deadline.  Rounds
+   up, so that the interrupt does not arrive early by more than
+   the calibration error. */
+void
+lapic_timer_oneshot (uint64_t tsc_cycles) {
+	uint64_t count;
+
+	ASSERT (lapic_timer_ready ());
+
+	count = tsc_cycles / timer_tsc * timer_counts
+		+ (tsc_cycles % timer_tsc * timer_counts + timer_tsc - 1) / timer_tsc;
+	if (count == 0)
+		count = 1;
+	else if (count > UINT32_MAX)
+		count = UINT32_MAX;
+	lapic_write (LAPIC_TIMER_INIT, count);
+}
+
+/* Returns the local APIC ID of the running CPU. */
+static uint32_t
+lapic_id (void) {
+	return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Returns the value of local APIC register REG. */
+static uint32_t
+lapic_read (unsigned reg) {
+	ASSERT (lapic != NULL);
+	return lapic[reg / sizeof *lapic];
+}
+
+/* Sets local APIC register REG to VALUE. */
+static void
+lapic_write (unsigned reg, uint32_t value) {
+	ASSERT (lapic != NULL);
+	lapic[reg / sizeof *lapic] = value;
+}
@@ -5,8 +5,12 @@
 #include <stdio.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/prof.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/lapic.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,9 +21,40 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency, and 8254 counts per timer tick. */
+#define PIT_FREQ 1193180
+#define PIT_TICK_COUNT ((PIT_FREQ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define PIT_MAX_COUNT 0xffff
+
+/* Number of timer ticks measured when calibrating the TSC. */
+#define TSC_CALIBRATE_TICKS 8
+
+/* CPUID leaf 0x80000007 EDX: TSC runs at a constant rate in every
+   power state. */
+#define CPUID_EDX_INVARIANT_TSC (1 << 8)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* -tickless: stop the periodic tick while the CPU is idle? */
+bool timer_tickless;
+
+/* TSC cycles per timer tick, and the TSC value at timer tick
+   clock_base_tick.  Set by timer_calibrate().  In tickless mode
+   timer_ticks() is derived from the TSC from then on, because
+   interrupts no longer arrive once per tick. */
+static uint64_t tsc_per_tick;
+static uint64_t clock_base_tsc;
+static int64_t clock_base_tick;
+
+/* True while the 8254 is programmed for a single interrupt
+   instead of the periodic tick. */
+static bool tick_stopped;
+
+/* Threads in a sub-tick sleep, earliest wake_up_tsc first.  The
+   local APIC timer is armed for the first one. */
+static struct heap hr_sleepers;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -28,12 +63,16 @@ static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
-
-/* Alarm Clock 추가 */
-int64_t get_next_tick_to_awake(void);
-void update_next_tick_to_awake(int64_t ticks);
-void thread_awake(int64_t ticks);
-void thread_sleep(int64_t ticks);
+static void pit_program (int mode, uint16_t count);
+static void calibrate_tsc (void);
+static bool tsc_invariant (void);
+static bool clock_ready (void);
+static int64_t clock_ticks (void);
+static bool hr_sleeper_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+static void hr_sleep (uint64_t cycles);
+static void hr_arm (void);
+static intr_handler_func hr_interrupt;
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -41,14 +80,19 @@ void thread_sleep(int64_t ticks);
 void
 timer_init (void) {
 	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	   nearest, in mode 2 (rate generator). */
+	pit_program (2, PIT_TICK_COUNT);
 
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+	heap_init (&hr_sleepers, hr_sleeper_less, NULL);
+}
+
+/* Programs 8254 counter 0 with COUNT in MODE. */
+static void
+pit_program (int mode, uint16_t count) {
+	outb (0x43, 0x30 | (mode << 1)); /* CW: counter 0, LSB then MSB, MODE, binary. */
 	outb (0x40, count & 0xff);
 	outb (0x40, count >> 8);
-
-	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
 
@@ -75,13 +119,104 @@ timer_calibrate (void) {
 			loops_per_tick |= test_bit;
 
 	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+	calibrate_tsc ();
+
+	/* Sub-tick sleeps block on the local APIC timer, if any. */
+	lapic_timer_calibrate (tsc_per_tick);
+	if (lapic_timer_ready ())
+		intr_register_ext (LAPIC_TIMER_VEC, hr_interrupt, "LAPIC Timer");
+}
+
+/* Measures tsc_per_tick against the 8254 and records the TSC
+   value at the current tick, so that clock_ticks() can take over
+   from the interrupt counter. */
+static void
+calibrate_tsc (void) {
+	enum intr_level old_level;
+	int64_t start;
+	uint64_t start_tsc, end_tsc;
+
+	/* Wait for a timer tick. */
+	start = ticks;
+	while (ticks == start)
+		barrier ();
+
+	start = ticks;
+	start_tsc = rdtsc ();
+	while (ticks < start + TSC_CALIBRATE_TICKS)
+		barrier ();
+	end_tsc = rdtsc ();
+
+	old_level = intr_disable ();
+	clock_base_tick = ticks;
+	clock_base_tsc = end_tsc;
+	tsc_per_tick = (end_tsc - start_tsc) / TSC_CALIBRATE_TICKS;
+	intr_set_level (old_level);
+
+	printf ("TSC: %'"PRIu64" cycles/s%s.\n", tsc_per_tick * TIMER_FREQ,
+			tsc_invariant () ? ", invariant" : "");
+}
+
+/* Returns true if the CPU says its TSC rate never changes. */
+static bool
+tsc_invariant (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (0x80000000, &eax, &ebx, &ecx, &edx);
+	if (eax < 0x80000007)
+		return false;
+	cpuid (0x80000007, &eax, &ebx, &ecx, &edx);
+	return (edx & CPUID_EDX_INVARIANT_TSC) != 0;
+}
+
+/* Returns true if the tick count is derived from the TSC. */
+static bool
+clock_ready (void) {
+	return timer_tickless && tsc_per_tick != 0;
+}
+
+/* Returns the number of timer ticks since the OS booted,
+   according to the TSC. */
+static int64_t
+clock_ticks (void) {
+	return clock_base_tick
+		+ (int64_t) ((rdtsc () - clock_base_tsc) / tsc_per_tick);
+}
+
+/* Returns the number of TSC cycles per timer tick, or 0 before
+   timer_calibrate() has measured it. */
+uint64_t
+timer_tsc_per_tick (void) {
+	return tsc_per_tick;
+}
+
+/* Converts CYCLES TSC cycles to nanoseconds.  Returns 0 before
+   timer_calibrate() has measured the TSC. */
+uint64_t
+timer_tsc_to_ns (uint64_t cycles) {
+	if (tsc_per_tick == 0)
+		return 0;
+	return cycles / tsc_per_tick * NS_PER_TICK
+		+ cycles % tsc_per_tick * NS_PER_TICK / tsc_per_tick;
+}
+
+/* Returns the number of nanoseconds since the OS booted.  Once
+   timer_calibrate() has measured the TSC this has the TSC's
+   resolution; before that it only advances once per tick. */
+uint64_t
+timer_ns (void) {
+	if (tsc_per_tick == 0)
+		return (uint64_t) ticks * NS_PER_TICK;
+	return (uint64_t) clock_base_tick * NS_PER_TICK
+		+ timer_tsc_to_ns (rdtsc () - clock_base_tsc);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) {
 	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
+	int64_t t = clock_ready () ? clock_ticks () : ticks;
 	intr_set_level (old_level);
 	barrier ();
 	return t;
@@ -133,6 +268,52 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, replaces the periodic tick with a
+   single interrupt at the start of tick NEXT_EVENT, or as late as
+   the 8254 can count if that is further away.  Nothing else can
+   become runnable without an interrupt, so the idle thread has
+   no time slice to enforce in the meantime. */
+void
+timer_idle_enter (int64_t next_event) {
+	int64_t now, max_event;
+	uint64_t due, now_tsc;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (!clock_ready () || tick_stopped)
+		return;
+
+	/* The periodic tick fires within one tick anyway. */
+	now = clock_ticks ();
+	if (next_event <= now + 1)
+		return;
+
+	max_event = now + PIT_MAX_COUNT / PIT_TICK_COUNT;
+	if (next_event > max_event)
+		next_event = max_event;
+
+	/* Round up so that the interrupt never arrives before the
+	   TSC says tick NEXT_EVENT has begun. */
+	due = clock_base_tsc + (uint64_t) (next_event - clock_base_tick) * tsc_per_tick;
+	now_tsc = rdtsc ();
+	if (due <= now_tsc)
+		return;
+	pit_program (0, (due - now_tsc) * PIT_TICK_COUNT / tsc_per_tick + 1);
+	tick_stopped = true;
+}
+
+/* Restores the periodic tick stopped by timer_idle_enter(), if
+   it is stopped.  Called when the idle thread is switched out. */
+void
+timer_idle_exit (void) {
+	enum intr_level old_level = intr_disable ();
+	if (tick_stopped) {
+		pit_program (2, PIT_TICK_COUNT);
+		tick_stopped = false;
+	}
+	intr_set_level (old_level);
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
@@ -148,9 +329,21 @@ timer_print_stats (void) {
 /* 타이머 하드웨어에 의해 매 틱마다 타이머 인터럽트가 걸리는데, 그때 타이머인터럽트 함수가 호출된다.
 	그래서 매 틱마다 get_next_tick_to_awake()함수를 통해 현재 깨워야할 thread가 있는지 thread_awake(ticks)함수로 확인한다 */
 static void
-timer_interrupt (struct intr_frame *args UNUSED) {
-	ticks++;
-	thread_tick ();
+timer_interrupt (struct intr_frame *args) {
+	int64_t now = ticks + 1;
+
+	prof_sample (args);
+
+	/* In tickless mode this may be the one-shot interrupt that ends
+	   an idle period, so catch up on every tick that has passed. */
+	if (clock_ready ()) {
+		timer_idle_exit ();
+		now = clock_ticks ();
+	}
+	while (ticks < now) {
+		ticks++;
+		thread_tick ();
+	}
 
 	/* --------- project 1 --------- */
 	int64_t next;
@@ -160,6 +353,9 @@ timer_interrupt (struct intr_frame *args UNUSED) {
 		thread_awake(ticks);
 	}
 	/* ----------------------------- */
+
+	if (workqueue_next_tick () <= ticks)
+		workqueue_timer (ticks);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -210,6 +406,10 @@ real_time_sleep (int64_t num, int32_t denom) {
 		   timer_sleep() because it will yield the CPU to other
 		   processes. */
 		timer_sleep (ticks);
+	} else if (lapic_timer_ready ()) {
+		/* Block until the local APIC timer fires.  NUM is less
+		   than DENOM / TIMER_FREQ here, so this cannot overflow. */
+		hr_sleep (num * (tsc_per_tick * TIMER_FREQ) / denom);
 	} else {
 		/* Otherwise, use a busy-wait loop for more accurate
 		   sub-tick timing.  We scale the numerator and denominator
@@ -218,3 +418,70 @@ real_time_sleep (int64_t num, int32_t denom) {
 		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
 	}
 }
+
+/* Orders hr_sleepers by wake_up_tsc. */
+static bool
+hr_sleeper_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, sleep_elem)->wake_up_tsc
+		< heap_entry (b, struct thread, sleep_elem)->wake_up_tsc;
+}
+
+/* Blocks the current thread for CYCLES TSC cycles, using a
+   one-shot local APIC timer interrupt to wake it up instead of
+   burning the CPU in busy_wait(). */
+static void
+hr_sleep (uint64_t cycles) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	curr->wake_up_tsc = rdtsc () + cycles;
+	heap_push (&hr_sleepers, &curr->sleep_elem);
+	hr_arm ();
+	thread_block ();
+	intr_set_level (old_level);
+}
+
+/* Arms the local APIC timer for the earliest sub-tick sleeper,
+   if there is one.  Interrupts must be off. */
+static void
+hr_arm (void) {
+	uint64_t due, now;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (heap_empty (&hr_sleepers))
+		return;
+
+	due = heap_entry (heap_min (&hr_sleepers), struct thread,
+			sleep_elem)->wake_up_tsc;
+	now = rdtsc ();
+	lapic_timer_oneshot (due > now ? due - now : 0);
+}
+
+/* Local APIC timer interrupt handler.  Wakes every sub-tick
+   sleeper whose deadline has passed and re-arms the timer for
+   the rest, so an interrupt that arrives a little early only
+   costs another one. */
+static void
+hr_interrupt (struct intr_frame *args UNUSED) {
+	uint64_t now = rdtsc ();
+	bool woken = false;
+
+	while (!heap_empty (&hr_sleepers)) {
+		struct thread *t = heap_entry (heap_min (&hr_sleepers),
+				struct thread, sleep_elem);
+
+		if (t->wake_up_tsc > now)
+			break;
+		heap_pop (&hr_sleepers);
+		if (thread_schedlat)
+			t->wake_tsc = t->wake_up_tsc;
+		thread_unblock (t);
+		woken = true;
+	}
+	hr_arm ();
+
+	if (woken && preempt_by_priority ())
+		intr_yield_on_return ();
+}
@@ -4,10 +4,23 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
+#include "threads/workqueue.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
 
+/* Allocations are written to disk before free_map_allocate()
+ * returns, so that a crash can never hand out a sector twice.
+ * Releases only leak sectors if lost, so their write is deferred
+ * to low-priority work, off the path of the remove() or close()
+ * that freed them, and several releases share one write. */
+static struct lock free_map_lock;    /* Protects free_map and its writes. */
+static bool free_map_dirty;          /* Released bits not yet on disk? */
+static struct work free_map_work;    /* Writes released bits. */
+
+static void free_map_flush (void *aux);
+
 /* Initializes the free map. */
 void
 free_map_init (void) {
@@ -16,6 +29,18 @@ free_map_init (void) {
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	lock_init (&free_map_lock);
+	work_init (&free_map_work, WORK_PRI_LOW, free_map_flush, NULL);
+}
+
+/* Writes the free map to disk if it has releases that are not
+ * there yet.  Runs as free_map_work. */
+static void
+free_map_flush (void *aux UNUSED) {
+	lock_acquire (&free_map_lock);
+	if (free_map_dirty && bitmap_write (free_map, free_map_file))
+		free_map_dirty = false;
+	lock_release (&free_map_lock);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,24 +49,34 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+	disk_sector_t sector;
+
+	lock_acquire (&free_map_lock);
+	sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+	if (sector != BITMAP_ERROR && free_map_file != NULL) {
+		if (bitmap_write (free_map, free_map_file))
+			free_map_dirty = false;
+		else {
+			bitmap_set_multiple (free_map, sector, cnt, false);
+			sector = BITMAP_ERROR;
+		}
 	}
+	lock_release (&free_map_lock);
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
 	return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use.  The
+ * free map is written back later by free_map_work. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
 	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	free_map_dirty = true;
+	lock_release (&free_map_lock);
+	queue_work (&free_map_work);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -57,6 +92,10 @@ free_map_open (void) {
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) {
+	/* If free_map_work is running, free_map_lock makes us wait for
+	   its write, and it touches nothing after releasing the lock. */
+	cancel_work (&free_map_work);
+	free_map_flush (NULL);
 	file_close (free_map_file);
 }
 
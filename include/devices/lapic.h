@@ -0,0 +1,19 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupt vectors 0x30...0x3f are raised by the local APIC
+   rather than the 8259A PICs. */
+#define LAPIC_TIMER_VEC 0x30            /* One-shot timer. */
+#define LAPIC_SPURIOUS_VEC 0x3f         /* Spurious interrupt. */
+
+void lapic_init (void);
+void lapic_eoi (void);
+
+void lapic_timer_calibrate (uint64_t tsc_cycles);
+bool lapic_timer_ready (void);
+void lapic_timer_oneshot (uint64_t tsc_cycles);
+
+#endif /* devices/lapic.h */
@@ -2,22 +2,36 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* Nanoseconds per timer tick. */
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+/* -tickless: stop the periodic tick while the CPU is idle?
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+uint64_t timer_tsc_per_tick (void);
+uint64_t timer_ns (void);
+uint64_t timer_tsc_to_ns (uint64_t cycles);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void timer_idle_enter (int64_t next_event);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
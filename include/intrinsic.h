@@ -119,6 +119,13 @@ static __inline uint64_t rcr2(void) {
 	return val;
 }
 
+__attribute__((always_inline))
+static __inline uint64_t rdtsc(void) {
+	uint32_t edx, eax;
+	__asm __volatile("rdtsc" : "=d" (edx), "=a" (eax));
+	return ((uint64_t) edx << 32) | eax;
+}
+
 __attribute__((always_inline))
 static __inline void write_msr(uint32_t ecx, uint64_t val) {
 	uint32_t edx, eax;
@@ -128,4 +135,56 @@ static __inline void write_msr(uint32_t ecx, uint64_t val) {
 			:: "c" (ecx), "d" (edx), "a" (eax) );
 }
 
+__attribute__((always_inline))
+static __inline uint64_t read_msr(uint32_t ecx) {
+	uint32_t edx, eax;
+	__asm __volatile("rdmsr" : "=d" (edx), "=a" (eax) : "c" (ecx));
+	return ((uint64_t) edx << 32) | eax;
+}
+
+__attribute__((always_inline))
+static __inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+		uint32_t *ecx, uint32_t *edx) {
+	__asm __volatile("cpuid"
+			: "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+			: "a" (leaf), "c" (0));
+}
+
+__attribute__((always_inline))
+static __inline uint64_t rcr0(void) {
+	uint64_t val;
+	__asm __volatile("movq %%cr0,%0" : "=r" (val));
+	return val;
+}
+
+__attribute__((always_inline))
+static __inline void lcr0(uint64_t val) {
+	__asm __volatile("movq %0, %%cr0" : : "r" (val));
+}
+
+__attribute__((always_inline))
+static __inline uint64_t rcr4(void) {
+	uint64_t val;
+	__asm __volatile("movq %%cr4,%0" : "=r" (val));
+	return val;
+}
+
+__attribute__((always_inline))
+static __inline void lcr4(uint64_t val) {
+	__asm __volatile("movq %0, %%cr4" : : "r" (val));
+}
+
+/* Clears CR0.TS, the task-switched flag. */
+__attribute__((always_inline))
+static __inline void clts(void) {
+	__asm __volatile("clts");
+}
+
+/* Writes extended control register ECX, e.g. XCR0. */
+__attribute__((always_inline))
+static __inline void xsetbv(uint32_t ecx, uint64_t val) {
+	__asm __volatile("xsetbv"
+			:: "c" (ecx), "d" ((uint32_t) (val >> 32)), "a" ((uint32_t) val));
+}
+
 #endif /* intrinsic.h */
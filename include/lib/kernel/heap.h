@@ -0,0 +1,70 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue (pairing heap).
+ *
+ * Like the list and hash table, this heap does not use dynamically
+ * allocated memory.  Each structure that can potentially be in a
+ * heap must embed a struct heap_elem member, and the heap_entry
+ * macro converts a struct heap_elem back to the structure object
+ * that contains it.  Refer to lib/kernel/list.h for a detailed
+ * explanation of the technique.
+ *
+ * The heap is ordered by a heap_less_func supplied to heap_init():
+ * heap_min() returns an element that no other element is less
+ * than.  To get a max-heap, supply a function that returns true
+ * when A is *greater* than B, the way list_insert_ordered()
+ * callers in thread.c and synch.c already do for priorities.
+ *
+ * Costs: heap_push() and heap_min() are O(1); heap_pop() and
+ * heap_remove() are O(log n) amortized.  An element whose key
+ * changes while it is in a heap must be repositioned with
+ * heap_update().  Elements that compare equal come out in no
+ * particular order, so break ties in the less function if FIFO
+ * order matters. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem {
+	struct heap_elem *child;    /* Leftmost child. */
+	struct heap_elem *sibling;  /* Next sibling to the right. */
+	struct heap_elem *prev;     /* Parent if leftmost, else left sibling. */
+};
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+ * the structure that HEAP_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)                   \
+	((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child            \
+		- offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+		const struct heap_elem *b, void *aux);
+
+/* Heap. */
+struct heap {
+	struct heap_elem *root;     /* Minimum element, or null. */
+	size_t size;                /* Number of elements. */
+	heap_less_func *less;       /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_min (const struct heap *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+size_t heap_size (const struct heap *);
+bool heap_empty (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
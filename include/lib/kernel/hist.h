@@ -0,0 +1,31 @@
+#ifndef __LIB_KERNEL_HIST_H
+#define __LIB_KERNEL_HIST_H
+
+/* Log2 histogram.
+ *
+ * Counts samples, such as TSC cycle counts, in power-of-two
+ * buckets: bucket B holds values in [2^(B+HIST_SHIFT),
+ * 2^(B+1+HIST_SHIFT)), except that the first bucket also takes
+ * everything smaller and the last everything larger.  Adding a
+ * sample is a bit scan and an increment, so histograms can be
+ * updated on hot paths such as the scheduler's.  They do no
+ * locking of their own. */
+
+#include <stdint.h>
+
+#define HIST_BUCKETS 24
+#define HIST_SHIFT 8
+
+/* Histogram. */
+struct hist {
+	uint32_t buckets[HIST_BUCKETS];  /* Sample counts. */
+	uint32_t count;                  /* Total # of samples. */
+	uint64_t max;                    /* Largest sample. */
+};
+
+void hist_init (struct hist *);
+void hist_add (struct hist *, uint64_t value);
+void hist_merge (struct hist *dst, const struct hist *src);
+void hist_print (const struct hist *, const char *title);
+
+#endif /* lib/kernel/hist.h */
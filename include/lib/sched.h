@@ -0,0 +1,17 @@
+#ifndef __LIB_SCHED_H
+#define __LIB_SCHED_H
+
+/* Scheduling policies, shared by the kernel and user programs.
+   A thread belongs to one class, and a ready thread of a higher
+   class always runs before any thread of a lower one: first the
+   real-time class (SCHED_FIFO and SCHED_RR), then the priority
+   class that the priority scheduler and MLFQS manage, and last
+   the proportional-share fair class. */
+enum sched_policy {
+	SCHED_FIFO,                 /* Real-time, runs until it blocks or yields. */
+	SCHED_RR,                   /* Real-time, round-robin time slices. */
+	SCHED_PRIO,                 /* Priority scheduling (the default). */
+	SCHED_FAIR,                 /* CPU time shared in proportion to nice. */
+};
+
+#endif /* lib/sched.h */
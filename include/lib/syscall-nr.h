@@ -36,6 +36,18 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Scheduling. */
+	SYS_SCHED_SETSCHEDULER,     /* Change scheduling class. */
+
+	/* User-space synchronization. */
+	SYS_FUTEX_WAIT,             /* Sleep while a futex holds a value. */
+	SYS_FUTEX_WAKE,             /* Wake threads sleeping on a futex. */
+
+	/* User threads. */
+	SYS_THREAD_CREATE,          /* Start a thread in this process. */
+	SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+	SYS_THREAD_EXIT,            /* Terminate the calling thread. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,32 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+#include <stdbool.h>
+
+/* Mutex built on futexes.  Locking and unlocking an uncontended
+   mutex take one atomic instruction each and no system call. */
+struct mutex {
+	int state;                  /* 0: unlocked, 1: locked,
+	                               2: locked, maybe with waiters. */
+};
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable for use with a struct mutex. */
+struct condvar {
+	int seq;                    /* Bumped by every signal. */
+};
+
+#define CONDVAR_INITIALIZER { 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/mutex.h */
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <sched.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -50,6 +51,31 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Scheduling.  POLICY is an enum sched_policy; returns 0 on
+   success, -1 on failure. */
+int sched_setscheduler (int policy, int priority);
+
+/* Futexes.  futex_wait() sleeps while *ADDR == EXPECTED, for at
+   most TIMEOUT_MS milliseconds unless it is negative, and returns
+   0 if woken by futex_wake() or -1 otherwise.  futex_wake() wakes
+   up to CNT sleepers and returns how many it woke.  See
+   <mutex.h> for locks built on them. */
+int futex_wait (int *addr, int expected, int timeout_ms);
+int futex_wake (int *addr, int cnt);
+
+/* User threads, sharing the address space and open files of the
+   process.  thread_create() starts FUNC (ARG) on a stack of its
+   own, with TLS as its FS base, and returns its tid or TID_ERROR.
+   FUNC must not return: it ends by calling thread_exit(), whose
+   STATUS thread_join() returns.  exit() ends every thread. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+typedef void thread_func (void *arg);
+
+tid_t thread_create (thread_func *func, void *arg, void *tls);
+int thread_join (tid_t);
+void thread_exit (int status) NO_RETURN;
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
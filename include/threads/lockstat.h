@@ -0,0 +1,19 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* -lockstat: keep contention statistics for locks and semaphores?
+   Controlled by kernel command-line option "-lockstat". */
+extern bool lockstat_enabled;
+
+struct lock_stat;
+
+struct lock_stat *lockstat_register (const char *name, bool is_lock);
+void lockstat_acquired (struct lock_stat *, bool contended, uint64_t wait,
+		void *site);
+void lockstat_released (struct lock_stat *, uint64_t hold);
+void lockstat_print_stats (void);
+
+#endif /* threads/lockstat.h */
@@ -11,13 +11,24 @@ enum palloc_flags {
 	PAL_USER = 004              /* User page. */
 };
 
+/* Largest block the buddy allocator keeps, as a power of two
+   pages: 1 << 10 pages is 4 MB. */
+#define PALLOC_MAX_ORDER 10
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* Number of pages to keep zeroed ahead of time in each pool. */
+extern size_t zero_page_limit;
+
 uint64_t palloc_init (void);
+void palloc_zero_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_block (enum palloc_flags, unsigned order);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_set_owner (void *page, void *owner);
+void *palloc_get_owner (const void *page);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,15 @@
+#ifndef THREADS_PROF_H
+#define THREADS_PROF_H
+
+#include "threads/interrupt.h"
+
+/* -prof=HZ: sample the interrupted code HZ times a second, or not
+   at all if 0.  Controlled by kernel command-line option
+   "-prof=HZ". */
+extern int prof_hz;
+
+void prof_init (void);
+void prof_sample (const struct intr_frame *);
+void prof_print_stats (void);
+
+#endif /* threads/prof.h */
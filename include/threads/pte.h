@@ -38,7 +38,14 @@
 #define PTE_P 0x1                        /* 1=present, 0=not present. */
 #define PTE_W 0x2                        /* 1=read/write, 0=read-only. */
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
+#define PTE_PWT 0x8                      /* 1=write-through caching. */
+#define PTE_PCD 0x10                     /* 1=caching disabled. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* 1=large page (PDPEs and PDEs only). */
+
+/* Bytes mapped by a PDE or a PDPE that has PTE_PS set. */
+#define PDX_PGSIZE  (1UL << PDXSHIFT)    /* 2 MB. */
+#define PDPE_PGSIZE (1UL << PDPESHIFT)   /* 1 GB. */
 
 #endif /* threads/pte.h */
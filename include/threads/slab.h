@@ -0,0 +1,50 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Objects a cache keeps ready to hand out without touching a
+   slab. */
+#define KMEM_HOT_CNT 32
+
+/* Sets up a new object in a slab.  Objects are constructed once,
+   when their slab is created, and must be freed in their
+   constructed state. */
+typedef void kmem_ctor (void *obj);
+
+/* A cache of objects of one size, carved out of page-size slabs.
+   See slab.c. */
+struct kmem_cache {
+	const char *name;           /* For statistics. */
+	size_t obj_size;            /* Object size as requested. */
+	size_t stride;              /* Bytes between objects in a slab. */
+	size_t link_ofs;            /* Offset of a free object's link. */
+	size_t objs_per_slab;       /* Objects in one slab. */
+	size_t colour_cnt;          /* Number of distinct colour offsets. */
+	size_t colour_next;         /* Colour of the next slab. */
+	kmem_ctor *ctor;            /* Constructor, or null. */
+
+	struct lock lock;           /* Protects `partial' and the slabs. */
+	struct list partial;        /* Slabs with free objects. */
+	size_t slab_cnt;            /* Slabs now allocated. */
+	size_t slab_max;            /* Most slabs ever allocated at once. */
+
+	/* Protected by disabling interrupts. */
+	void *hot[KMEM_HOT_CNT];    /* Recently freed objects, LIFO. */
+	size_t hot_cnt;             /* Number of objects in `hot'. */
+	uint64_t alloc_cnt;         /* kmem_cache_alloc() calls that succeeded. */
+	uint64_t free_cnt;          /* kmem_cache_free() calls. */
+	uint64_t hot_hits;          /* Allocations served from `hot'. */
+};
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		kmem_ctor *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void *kmem_cache_zalloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *obj);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,17 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* Kernel thread switching, in switch.S.
+ *
+ * Both save the running thread's callee-saved registers on its
+ * stack and its stack pointer in *CUR_RSP, and return when the
+ * thread is switched back to with switch_threads().  switch_threads()
+ * resumes a thread stopped the same way at NEXT_RSP; switch_first()
+ * starts a thread that has never run from NEXT_TF with do_iret(). */
+void switch_threads (uint64_t *cur_rsp, uint64_t next_rsp);
+void switch_first (uint64_t *cur_rsp, struct intr_frame *next_tf);
+
+#endif /* threads/switch.h */
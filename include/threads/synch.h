@@ -2,45 +2,66 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <heap.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+struct lock_stat;
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. 공유 자원의 수 */
-	struct list waiters;        /* List of waiting threads. 공유 자원을 사용하기 위해 대기하고 있는 스레드들의 리스트 */
+	struct heap waiters;        /* Waiting threads, highest priority first. 공유 자원을 사용하기 위해 대기하고 있는 스레드들 */
+	struct lock_stat *stat;     /* Statistics under -lockstat, or null. */
 };
 
-/* One semaphore in a list. */
+/* One semaphore in a condition variable's heap. */
 struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
+	struct heap_elem elem;              /* Heap element. */
 	struct semaphore semaphore;         /* This semaphore. */
+	struct thread *thread;              /* Thread waiting on it. */
 };
 
-void sema_init (struct semaphore *, unsigned value);
+void sema_init_named (struct semaphore *, unsigned value, const char *name);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
-/* PROJECT1: THREADS - Priority Scheduling */
-bool sema_compare_priority (const struct list_elem *l, const struct list_elem *s, void *aux);
-
+/* Initializes SEMA to VALUE, named after the source text of SEMA
+   for -lockstat. */
+#define sema_init(SEMA, VALUE) sema_init_named (SEMA, VALUE, #SEMA)
 
-/* Lock. */
+/* Lock.  Threads waiting for a lock donate their priority to its
+   holder: they sit in the lock's `donors' max-heap, and the holder
+   keeps each lock it holds in its `held_locks' heap keyed on that
+   lock's top donor, so its donated priority is always the top of
+   the top. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct heap donors;         /* Waiting threads, highest priority first. */
+	struct heap_elem held_elem; /* Element in holder's `held_locks'. */
+	struct lock_stat *stat;     /* Statistics under -lockstat, or null. */
+	uint64_t acquire_tsc;       /* TSC when acquired, under -lockstat. */
 };
 
-void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+bool lock_donation_more (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+
+/* Initializes LOCK, named after the source text of LOCK for
+   -lockstat. */
+#define lock_init(LOCK) lock_init_named (LOCK, #LOCK)
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* struct semaphore_elem of each waiter. */
 };
 
 void cond_init (struct condition *);
@@ -48,6 +69,91 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Wait queue.  Threads sleep on it until a condition of their
+   choosing holds, and whoever may have made it hold wakes the
+   queue.  A waiter rechecks its condition on every wakeup, so
+   wakeups are only hints.
+
+   A waiter is either non-exclusive, and woken by every wake_up(),
+   or exclusive, in which case wake_up() wakes only the
+   highest-priority one of them.  Exclusive waiters suit events
+   that only one waiter can consume, such as a freed resource, and
+   then N waiters cost one wakeup per event instead of N. */
+struct wait_queue {
+	struct list waiters;        /* struct wait_entry of each waiter. */
+};
+
+/* Returns true once the awaited condition holds. */
+typedef bool wait_cond_func (void *aux);
+
+void wait_queue_init (struct wait_queue *);
+bool wait_queue_active (struct wait_queue *);
+void wait_event (struct wait_queue *, wait_cond_func *, void *aux);
+void wait_event_exclusive (struct wait_queue *, wait_cond_func *, void *aux);
+bool wait_event_timeout (struct wait_queue *, wait_cond_func *, void *aux,
+		bool exclusive, int64_t ticks);
+void wait_event_lock (struct wait_queue *, wait_cond_func *, void *aux,
+		struct lock *);
+int wake_up (struct wait_queue *);
+int wake_up_all (struct wait_queue *);
+
+/* Reader-writer lock.  Either any number of readers or a single
+   writer may hold it.  Waiting writers are preferred over new
+   readers, so a steady stream of readers cannot starve them, and
+   a thread that blocks donates its priority to every holder. */
+struct rwlock {
+	struct thread *writer;      /* Thread holding it for writing, or null. */
+	unsigned readers;           /* # of threads holding it for reading. */
+	struct list holders;        /* struct rwlock_hold of each holder. */
+	struct heap read_waiters;   /* Threads waiting to read, highest priority first. */
+	struct heap write_waiters;  /* Threads waiting to write, highest priority first. */
+};
+
+/* One thread's hold on an rwlock.  The holder keeps it in its
+   `held_rwlocks' heap, keyed on the rwlock's top waiter, just as
+   it keeps the locks it holds in `held_locks'.  Each thread has
+   RWLOCK_HOLD_MAX of these, so taking an rwlock never allocates.
+   Holds beyond that are only counted: they work, but get no
+   donations. */
+#define RWLOCK_HOLD_MAX 8
+struct rwlock_hold {
+	struct list_elem elem;      /* Element in rwlock's `holders'. */
+	struct heap_elem held_elem; /* Element in holder's `held_rwlocks'. */
+	struct rwlock *rwlock;      /* Held rwlock, or null if unused. */
+	struct thread *thread;      /* Holder. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+bool rwlock_donation_more (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+
+/* Spinlock.  Busy-waits instead of sleeping, and keeps
+   interrupts off on this CPU while held, so it protects data
+   shared with other CPUs and with interrupt handlers alike.
+   Hold one only briefly and never sleep while holding it. */
+struct spinlock {
+	volatile int locked;        /* 1 while held. */
+	enum intr_level old_level;  /* Holder's level before acquiring. */
+	struct lock_stat *stat;     /* Statistics under -lockstat, or null. */
+	uint64_t acquire_tsc;       /* TSC when acquired, under -lockstat. */
+};
+
+void spinlock_init_named (struct spinlock *, const char *name);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held (const struct spinlock *);
+
+/* Initializes LOCK, named after the source text of LOCK for
+   -lockstat. */
+#define spinlock_init(LOCK) spinlock_init_named (LOCK, #LOCK)
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -56,6 +162,6 @@ void cond_broadcast (struct condition *, struct lock *);
 #define barrier() asm volatile ("" : : : "memory")
 
 /* ----------------- project 1 ----------------- */
-static bool sema_priority_compare(const struct list_elem *a, const struct list_elem *b, void *aux);
+void reset_priority (void);
 /* --------------------------------------------- */
 #endif /* threads/synch.h */
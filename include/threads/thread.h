@@ -3,8 +3,12 @@
 
 #include <debug.h>
 #include <list.h>
+#include <heap.h>
+#include <sched.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/fixed_point.h"
 #include "filesys/file.h"  /* P2_3 System Call 추가 */
 #ifdef VM
 #include "vm/vm.h"
@@ -29,8 +33,13 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness (MLFQS). */
+#define NICE_MIN -20                    /* Nicest. */
+#define NICE_DEFAULT 0                  /* Default nice. */
+#define NICE_MAX 20                     /* Least nice. */
+
 /* ------------------ project2 -------------------- */
-#define FDT_PAGES 3		/* pages to allocate for file descriptor tables (thread_create, process_exit) */
+#define FDT_PAGES 1		/* pages to allocate for file descriptor tables (thread_fdt_alloc); one, so that the zero pool serves it */
 #define FDCOUNT_LIMIT FDT_PAGES *(1 << 9)		/* limit fd_idx */
 /* ------------------------------------------------ */
 
@@ -117,18 +126,34 @@ struct thread {
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
+	enum sched_policy policy;           /* Scheduling class. */
+	uint64_t vruntime;                  /* SCHED_FAIR: weighted ns of CPU used. */
+	struct heap_elem fair_elem;         /* SCHED_FAIR: element in run queue. */
+	struct list_elem all_elem;          /* List element for all threads list. */
 
-	/* 쓰레드 디스크립터 필드 추가 */
-	int64_t wakeup_tick;	/* 깨어나야 할 tick을 저장할 변수 추가 */
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
 
 	/* ----- PROJECT 1 --------- */
 	int64_t wake_up_tick; /* thread's wakeup_time */
+	struct heap_elem sleep_elem; /* element of sleep_heap while sleeping */
+	bool sleeping; /* in sleep_heap? */
+	uint64_t wake_up_tsc; /* TSC deadline of a sub-tick sleep */
 	int initial_priority; /* thread's initial priority */
 	struct lock *wait_on_lock; /* which lock thread is waiting for  */
-	struct list donation_list; /* list of threads that donate priority to **this thread** */
-	struct list_elem donation_elem; /* prev and next pointer of donation_list where **this thread donate** */
+	struct heap held_locks; /* locks this thread holds, by their top donor's priority */
+	struct heap_elem donor_elem; /* element of wait_on_lock's donors heap */
+	struct heap_elem wait_elem; /* element of a semaphore's waiters heap */
+	struct heap *wait_heap; /* sema or cond waiters heap this thread is queued in */
+	struct heap_elem *wait_link; /* this thread's element in wait_heap */
+	uint64_t wait_seq; /* FIFO order among waiters of equal priority */
+	struct rwlock *wait_on_rwlock; /* which rwlock thread is waiting for */
+	struct heap held_rwlocks; /* holds on rwlocks, by their top waiter's priority */
+	struct rwlock_hold rwlock_holds[RWLOCK_HOLD_MAX]; /* rwlocks this thread holds */
+	unsigned rwlock_overflow; /* holds that didn't fit in rwlock_holds */
+	int nice;                  /* MLFQS niceness */
+	fixed_t recent_cpu;        /* MLFQS recent_cpu, decayed up to cpu_epoch */
+	int64_t cpu_epoch;         /* last second recent_cpu was decayed for */
 	/* ------------------------- */
 
 	/* ---------- Project 2 ---------- */
@@ -140,38 +165,37 @@ struct thread {
 	struct semaphore fork_sema; /* parent thread should wait while child thread copy parent */
 	struct semaphore wait_sema;
 	struct semaphore free_sema;
-	struct file **fd_table;   /* allocated in thread_create */	
+	struct file **fd_table;   /* allocated on first open, or null */	
 	struct file *running;
 	/* ------------------------------- */
 	
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
-	uint64_t *pml4;                     /* Page map level 4 */
+	uint64_t *pml4;                     /* Page map level 4, shared by the process's threads */
+	struct process *proc;               /* User process, or null for kernel threads */
+	int ustack_slot;                    /* Its user stack slot, see USTACK_SIZE */
+	uint64_t fs_base;                   /* User TLS pointer, loaded into FS base */
+	void *fpu;                          /* FPU/SSE save area from first use, or null */
 #endif
 #ifdef VM
-	/* Table for whole virtual memory owned by thread. */
-	struct supplemental_page_table spt;
 	void *stack_bottom;
 #endif
 
 	// Project 3-2 stack growth
 	uint64_t rsp; // a page fault occurs in the kernel
 	
+	/* Scheduler latency tracing (-schedlat), owned by thread.c. */
+	uint64_t ready_tsc;                 /* TSC when it last became ready. */
+	uint64_t wake_tsc;                  /* TSC at its sleep deadline, or 0. */
+	struct thread_latency *latency;     /* Its histograms, or null. */
+
 	/* Owned by thread.c. */
-	struct intr_frame tf;               /* Information for switching */
+	struct intr_frame tf;               /* Context for its first launch */
+	uint64_t switch_rsp;                /* Saved rsp while switched out, see switch.S */
 	unsigned magic;                     /* Detects stack overflow. */
 	/* 이 값은 thread.c에 정의된 임의의 숫자이며, 스택 오버플로를 감지하는데 사용된다. 
 	thread_current()는 실행 중인 스레드 구조체의 magic 멤버가 THREAD_MAGIC으로 설정 되었는지 확인한다. 
 	스택 오버플로로 인해 이 값이 변경되어 ASSERT가 발생하는 경우가 있다. */
-
-	/* Donate 추가 */
-	int init_priority; /* 스레드가 priority 를 양도받았다가 다시 반납할 때 원래의 priority 를 복원할 수 있도록 고유의 priority 값을 저장하는 변수 */
-    struct lock *wait_on_lock;		/* 스레드가 현재 얻기 위해 기다리고 있는 lock 으로 스레드는 이 lock 이 release 되기를 기다린다 */
-    struct list donations;			/* 자신에게 priority 를 나누어준 스레드들의 리스트 */
-    struct list_elem donation_elem;	/* 이 리스트를 관리하기 위한 element 로 thread 구조체의 그냥 elem 과 구분하여 사용한다 */
-	/* P2_3 System Call 추가 */
-	struct file **fd_table;
-	int fd_idx;
 };
 
 /* If false (default), use round-robin scheduler.
@@ -179,6 +203,11 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, time how long threads wait in the run queue and how
+   late they run after sleeping, and print histograms of both at
+   shutdown.  Controlled by kernel command-line option "-schedlat". */
+extern bool thread_schedlat;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -200,6 +229,12 @@ void thread_yield (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *, int);
+bool thread_set_policy (enum sched_policy, int priority);
+
+struct file **thread_fdt_alloc (void);
+void thread_fdt_free (struct file **);
+bool thread_shrink_caches (void);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -211,10 +246,11 @@ void do_iret (struct intr_frame *tf);
 /* ------------- project 1 ------------ */
 void thread_sleep(int64_t ticks);
 void thread_awake(int64_t ticks);
+void thread_block_until (int64_t until);
+void thread_wake (struct thread *t);
 int64_t get_next_tick_to_awake(void);
 bool thread_priority_compare (struct list_elem *element1, struct list_elem *element2, void *aux);
 bool preempt_by_priority(void);
-bool thread_donate_priority_compare (struct list_elem *element1, struct list_elem *element2, void *aux);
 /* ------------------------------------- */
 /* ------------------- project 2 -------------------- */
 struct thread* get_child_by_tid(tid_t tid);
@@ -0,0 +1,46 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <heap.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Priorities of deferred work.  Higher priority work is always
+   started first, and its worker runs at a higher thread priority. */
+enum work_priority {
+	WORK_PRI_HIGH,              /* Latency matters, e.g. I/O completion. */
+	WORK_PRI_NORMAL,            /* Ordinary deferred work. */
+	WORK_PRI_LOW,               /* Housekeeping, e.g. page zeroing. */
+	WORK_PRI_CNT                /* Number of priorities. */
+};
+
+typedef void work_func (void *aux);
+
+/* A unit of deferred work, run once by a worker thread each time
+   it is queued.  Owned by the caller, who must keep it alive
+   until it has run or been cancelled; FUNC may free it. */
+struct work {
+	work_func *func;            /* Function to call. */
+	void *aux;                  /* Its argument. */
+	enum work_priority priority;
+	bool pending;               /* Queued or delayed, not yet started? */
+	bool delayed;               /* Waiting in the delayed heap? */
+	int64_t expires;            /* Delayed: tick to queue at. */
+	struct list_elem elem;      /* Element in its priority's queue. */
+	struct heap_elem timer_elem; /* Element in the delayed heap. */
+};
+
+void workqueue_init (void);
+void work_init (struct work *, enum work_priority, work_func *, void *aux);
+bool queue_work (struct work *);
+bool queue_delayed_work (struct work *, int64_t ticks);
+bool cancel_work (struct work *);
+bool cancel_work_sync (struct work *);
+void flush_work (struct work *);
+void flush_workqueue (void);
+
+int64_t workqueue_next_tick (void);
+void workqueue_timer (int64_t ticks);
+
+#endif /* threads/workqueue.h */
@@ -0,0 +1,12 @@
+#ifndef USERPROG_FPU_H
+#define USERPROG_FPU_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+void fpu_init (void);
+void fpu_activate (struct thread *next);
+bool fpu_copy (struct thread *dst, struct thread *src);
+void fpu_free (struct thread *);
+
+#endif /* userprog/fpu.h */
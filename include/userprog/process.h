@@ -2,6 +2,39 @@
 #define USERPROG_PROCESS_H
 
 #include "threads/thread.h"
+#include "filesys/off_t.h"
+
+/* Each user thread runs on its own stack, carved out of the USTACK_SIZE
+   slot below the previous thread's: slot 0 is the initial thread's,
+   ending at USER_STACK.  A process has at most UTHREAD_MAX threads. */
+#define USTACK_SIZE (1 << 20)
+#define UTHREAD_MAX 16
+
+/* A user process: the state its threads share.  Every thread of the
+   process, the initial one (the "leader") included, points to it and
+   holds a reference; the leader frees it once it is the last one.
+   The page table and file descriptor table are shared by giving each
+   thread the same pml4 and fd_table pointers. */
+struct process {
+	tid_t pid;                  /* Tid of the leader. */
+	struct lock lock;           /* Protects the members below. */
+	struct wait_queue leader_wq; /* Leader waiting for the others. */
+	int thread_cnt;             /* Live threads, the leader included. */
+	bool exiting;               /* Told to exit? Threads exit on kernel entry. */
+	int exit_status;            /* If exiting, the status to exit with. */
+	struct list uthreads;       /* struct uthread of unjoined threads. */
+	uint32_t stack_slots;       /* Bitmap of stack slots in use. */
+#ifdef VM
+	/* Table for whole virtual memory owned by the process. */
+	struct supplemental_page_table spt;
+#endif
+};
+
+struct container {
+	struct file *file;
+	off_t offset;
+	size_t page_read_bytes;
+};
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
@@ -11,10 +44,11 @@ void process_exit (void);
 void process_activate (struct thread *next);
 void argument_stack (int argc, char **argv, struct intr_frame *if_);
 
-#endif /* userprog/process.h */
+tid_t process_thread_create (void *entry, void *arg, void *tls);
+int process_thread_join (tid_t);
+void process_thread_exit (int status) NO_RETURN;
+bool process_set_exiting (int status);
+void process_check_exiting (void);
+bool process_stack_contains (const void *uaddr);
 
-struct container {
-    struct file *file;
-    off_t offset;
-    size_t page_read_bytes;
-};
\ No newline at end of file
+#endif /* userprog/process.h */
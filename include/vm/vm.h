@@ -131,6 +131,8 @@ struct lazy_load_info {
 	size_t page_zero_bytes;
 	off_t offset;
 };
+struct lazy_load_info *lazy_load_info_alloc (void);
+void lazy_load_info_free (struct lazy_load_info *);
 
 // spt_remove_page without deleting the page from SPT
 void remove_page(struct page *page);
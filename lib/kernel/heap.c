@@ -0,0 +1,164 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a multiway tree kept in heap order: no child
+   is less than its parent, so the root is always the minimum.
+   Children are linked left to right through `sibling', and each
+   element's `prev' points to its parent if it is the leftmost
+   child, or to its left sibling otherwise.  The root's `prev' and
+   `sibling' are null.
+
+   Two heaps are "melded" by making the larger root the leftmost
+   child of the smaller one, which takes constant time.  Removing
+   the root leaves a list of subtrees that is melded back together
+   in two passes, first pairing neighbours left to right and then
+   folding the pairs right to left; that is what keeps the
+   amortized cost of heap_pop() logarithmic. */
+
+/* Makes the larger of roots A and B the leftmost child of the
+   smaller one and returns the new root.  A and B must be detached
+   (null `prev' and `sibling').  Ties keep A as the root. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	if (heap->less (b, a, heap->aux)) {
+		struct heap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	b->prev = a;
+	b->sibling = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Melds the sibling list starting at FIRST into a single tree
+   and returns its root, or a null pointer if FIRST is null. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* First pass: meld neighbours pairwise, left to right,
+	   collecting the results in reverse order through `sibling'. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->sibling;
+
+		first = b != NULL ? b->sibling : NULL;
+		a->prev = a->sibling = NULL;
+		if (b != NULL) {
+			b->prev = b->sibling = NULL;
+			a = meld (heap, a, b);
+		}
+		a->sibling = pairs;
+		pairs = a;
+	}
+
+	/* Second pass: fold the pairs right to left. */
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->sibling;
+
+		pairs->sibling = NULL;
+		root = root != NULL ? meld (heap, root, pairs) : pairs;
+		pairs = next;
+	}
+	return root;
+}
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->size = 0;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->sibling = elem->prev = NULL;
+	heap->root = heap->root != NULL ? meld (heap, heap->root, elem) : elem;
+	heap->size++;
+}
+
+/* Returns the minimum element in HEAP.
+   Undefined behavior if HEAP is empty. */
+struct heap_elem *
+heap_min (const struct heap *heap) {
+	ASSERT (!heap_empty (heap));
+	return heap->root;
+}
+
+/* Removes the minimum element from HEAP and returns it.
+   Undefined behavior if HEAP is empty before removal. */
+struct heap_elem *
+heap_pop (struct heap *heap) {
+	struct heap_elem *min = heap_min (heap);
+
+	heap->root = merge_pairs (heap, min->child);
+	heap->size--;
+	min->child = NULL;
+	return min;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	struct heap_elem *sub;
+
+	ASSERT (!heap_empty (heap));
+
+	if (elem == heap->root) {
+		heap_pop (heap);
+		return;
+	}
+
+	/* Unlink ELEM, with its subtree, from its parent or left
+	   sibling, then meld what is left of the subtree back in. */
+	ASSERT (elem->prev != NULL);
+	if (elem->prev->child == elem)
+		elem->prev->child = elem->sibling;
+	else
+		elem->prev->sibling = elem->sibling;
+	if (elem->sibling != NULL)
+		elem->sibling->prev = elem->prev;
+
+	sub = merge_pairs (heap, elem->child);
+	if (sub != NULL)
+		heap->root = meld (heap, heap->root, sub);
+	heap->size--;
+	elem->child = elem->sibling = elem->prev = NULL;
+}
+
+/* Restores heap order after the key of ELEM, which must be in
+   HEAP, has changed in either direction. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem) {
+	heap_remove (heap, elem);
+	heap_push (heap, elem);
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (const struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->root == NULL;
+}
@@ -0,0 +1,49 @@
+#include "hist.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "../debug.h"
+
+/* Initializes H as an empty histogram. */
+void
+hist_init (struct hist *h) {
+	ASSERT (h != NULL);
+	memset (h, 0, sizeof *h);
+}
+
+/* Adds a sample of VALUE to H. */
+void
+hist_add (struct hist *h, uint64_t value) {
+	int b = value != 0 ? 63 - __builtin_clzll (value) - HIST_SHIFT : 0;
+
+	if (b < 0)
+		b = 0;
+	else if (b >= HIST_BUCKETS)
+		b = HIST_BUCKETS - 1;
+	h->buckets[b]++;
+	h->count++;
+	if (value > h->max)
+		h->max = value;
+}
+
+/* Adds the samples of SRC to DST. */
+void
+hist_merge (struct hist *dst, const struct hist *src) {
+	for (int b = 0; b < HIST_BUCKETS; b++)
+		dst->buckets[b] += src->buckets[b];
+	dst->count += src->count;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/* Prints H under TITLE, one line per non-empty bucket giving
+   the bucket's lower bound and sample count. */
+void
+hist_print (const struct hist *h, const char *title) {
+	printf ("%s: %"PRIu32" samples, max %"PRIu64"\n", title, h->count, h->max);
+	for (int b = 0; b < HIST_BUCKETS; b++)
+		if (h->buckets[b] != 0)
+			printf ("  %s%12"PRIu64": %"PRIu32"\n", b == 0 ? "<" : ">=",
+					b == 0 ? (uint64_t) 2 << HIST_SHIFT : (uint64_t) 1 << (b + HIST_SHIFT),
+					h->buckets[b]);
+}
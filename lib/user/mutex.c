@@ -0,0 +1,89 @@
+#include <mutex.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* The mutex follows "mutex, take 2" of Ulrich Drepper's "Futexes
+   Are Tricky": a locker that finds the mutex held marks it
+   contended (2) before sleeping, and an unlocker only calls
+   futex_wake() if the mutex was marked. */
+
+/* Atomically sets *P to NEW if it equals OLD.  Returns the value
+   *P had. */
+static int
+cmpxchg (int *p, int old, int new) {
+	__atomic_compare_exchange_n (p, &old, new, false, __ATOMIC_ACQUIRE,
+			__ATOMIC_RELAXED);
+	return old;
+}
+
+/* Acquires M, marked contended, sleeping while someone else
+   holds it.  Once we may have slept we cannot know whether others
+   sleep too, so we must leave it marked. */
+static void
+mutex_lock_contended (struct mutex *m) {
+	while (__atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE) != 0)
+		futex_wait (&m->state, 2, -1);
+}
+
+void
+mutex_init (struct mutex *m) {
+	m->state = 0;
+}
+
+/* Acquires M, sleeping until it is available if necessary. */
+void
+mutex_lock (struct mutex *m) {
+	if (cmpxchg (&m->state, 0, 1) != 0)
+		mutex_lock_contended (m);
+}
+
+/* Acquires M if it is available.  Returns true if successful. */
+bool
+mutex_trylock (struct mutex *m) {
+	return cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, which the caller must hold, and wakes one waiter
+   if there may be any. */
+void
+mutex_unlock (struct mutex *m) {
+	if (__atomic_fetch_sub (&m->state, 1, __ATOMIC_RELEASE) != 1) {
+		__atomic_store_n (&m->state, 0, __ATOMIC_RELEASE);
+		futex_wake (&m->state, 1);
+	}
+}
+
+void
+condvar_init (struct condvar *cv) {
+	cv->seq = 0;
+}
+
+/* Atomically releases M and waits for CV to be signaled, then
+   reacquires M.  As with any condition variable, the caller must
+   check its condition again on return.  A signal sent between
+   reading `seq' and sleeping changes it, so futex_wait() returns
+   at once instead of missing the signal. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m) {
+	int seq = __atomic_load_n (&cv->seq, __ATOMIC_RELAXED);
+
+	mutex_unlock (m);
+	futex_wait (&cv->seq, seq, -1);
+
+	/* Threads woken by the same broadcast may be waiting for M. */
+	mutex_lock_contended (m);
+}
+
+/* Wakes one thread waiting on CV, if any. */
+void
+condvar_signal (struct condvar *cv) {
+	__atomic_fetch_add (&cv->seq, 1, __ATOMIC_RELEASE);
+	futex_wake (&cv->seq, 1);
+}
+
+/* Wakes every thread waiting on CV. */
+void
+condvar_broadcast (struct condvar *cv) {
+	__atomic_fetch_add (&cv->seq, 1, __ATOMIC_RELEASE);
+	futex_wake (&cv->seq, INT_MAX);
+}
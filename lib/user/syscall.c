@@ -194,3 +194,34 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+sched_setscheduler (int policy, int priority) {
+	return syscall2 (SYS_SCHED_SETSCHEDULER, policy, priority);
+}
+
+int
+futex_wait (int *addr, int expected, int timeout_ms) {
+	return syscall3 (SYS_FUTEX_WAIT, addr, expected, timeout_ms);
+}
+
+int
+futex_wake (int *addr, int cnt) {
+	return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+tid_t
+thread_create (thread_func *func, void *arg, void *tls) {
+	return (tid_t) syscall3 (SYS_THREAD_CREATE, func, arg, tls);
+}
+
+int
+thread_join (tid_t tid) {
+	return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (int status) {
+	syscall1 (SYS_THREAD_EXIT, status);
+	NOT_REACHED ();
+}
@@ -0,0 +1,103 @@
+/* Low-priority main thread L holds several reader-writer locks
+   for reading, among them R.  Medium-priority thread M acquires
+   lock A, then blocks on acquiring R for writing.  High-priority
+   thread H then blocks on acquiring lock A.  Thus, thread H
+   donates its priority to M, which in turn donates it through R
+   to thread L.  L also takes more rwlocks after R than fit in
+   its rwlock holds, which must not matter. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define EXTRA_CNT RWLOCK_HOLD_MAX
+
+struct locks 
+  {
+    struct lock *a;
+    struct rwlock *r;
+  };
+
+static thread_func medium_thread_func;
+static thread_func high_thread_func;
+
+void
+test_priority_donate_rwlock_nest (void) 
+{
+  struct rwlock extra[EXTRA_CNT];
+  struct rwlock r;
+  struct lock a;
+  struct locks locks;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&r);
+  lock_init (&a);
+
+  rwlock_acquire_read (&r);
+  for (i = 0; i < EXTRA_CNT; i++)
+    {
+      rwlock_init (&extra[i]);
+      rwlock_acquire_read (&extra[i]);
+    }
+
+  locks.a = &a;
+  locks.r = &r;
+  thread_create ("medium", PRI_DEFAULT + 1, medium_thread_func, &locks);
+  thread_yield ();
+  msg ("Low thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+
+  thread_create ("high", PRI_DEFAULT + 2, high_thread_func, &a);
+  thread_yield ();
+  for (i = 0; i < EXTRA_CNT; i++)
+    rwlock_release_read (&extra[i]);
+  msg ("Low thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+
+  rwlock_release_read (&r);
+  thread_yield ();
+  msg ("Medium thread should just have finished.");
+  msg ("Low thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+medium_thread_func (void *locks_) 
+{
+  struct locks *locks = locks_;
+
+  lock_acquire (locks->a);
+  rwlock_acquire_write (locks->r);
+
+  msg ("Medium thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  msg ("Medium thread got the rwlock.");
+
+  rwlock_release_write (locks->r);
+  thread_yield ();
+
+  lock_release (locks->a);
+  thread_yield ();
+
+  msg ("High thread should have just finished.");
+  msg ("Middle thread finished.");
+}
+
+static void
+high_thread_func (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  msg ("High thread got the lock.");
+  lock_release (lock);
+  msg ("High thread finished.");
+}
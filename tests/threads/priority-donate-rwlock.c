@@ -0,0 +1,61 @@
+/* The main thread acquires a reader-writer lock for reading.
+   Then it creates a higher-priority writer, which blocks, and an
+   even higher-priority reader, which also blocks because a
+   writer is waiting.  Both donate their priorities to the main
+   thread.  When the main thread releases the lock, the writer
+   must get it before the reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_priority_donate_rwlock (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_acquire_read (&rwlock);
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  thread_create ("reader", PRI_DEFAULT + 3, reader_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 3, thread_get_priority ());
+  rwlock_release_read (&rwlock);
+  msg ("writer, reader must already have finished.");
+  msg ("This should be the last line before finishing this test.");
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_write (rwlock);
+  msg ("writer: got the lock");
+  rwlock_release_write (rwlock);
+  msg ("writer: done");
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_read (rwlock);
+  msg ("reader: got the lock");
+  rwlock_release_read (rwlock);
+  msg ("reader: done");
+}
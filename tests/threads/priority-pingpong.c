@@ -0,0 +1,60 @@
+/* Measures the cost of a thread switch.  The main thread and a
+   higher-priority thread hand control back and forth through a
+   pair of semaphores, so that every sema_up() preempts the main
+   thread or every sema_down() blocks the other one, and each
+   round trip takes exactly two switches. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ROUNDS 10000
+
+static thread_func pingpong_thread;
+static struct semaphore ping, pong;
+static int rounds;
+
+void
+test_priority_pingpong (void) 
+{
+  uint64_t start, elapsed;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  thread_create ("pong", PRI_DEFAULT + 1, pingpong_thread, NULL);
+
+  start = timer_ns ();
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      sema_up (&ping);
+      sema_down (&pong);
+    }
+  elapsed = timer_ns () - start;
+
+  if (rounds != ROUNDS)
+    fail ("pong thread ran %d rounds, expected %d", rounds, ROUNDS);
+  msg ("%d switches, %"PRIu64" ns per switch",
+       2 * ROUNDS, elapsed / (2 * ROUNDS));
+  pass ();
+}
+
+static void
+pingpong_thread (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      sema_down (&ping);
+      rounds++;
+      sema_up (&pong);
+    }
+}
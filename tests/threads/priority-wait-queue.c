@@ -0,0 +1,92 @@
+/* Tests wait queues.  wake_up() wakes every non-exclusive waiter
+   but only the highest-priority exclusive one, wake_up() with the
+   condition now true lets the non-exclusive waiters run in priority
+   order, and wait_event_timeout() gives up when nothing wakes it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func exclusive_thread, shared_thread;
+static struct wait_queue wq;
+static int tokens;
+static bool go;
+
+static bool
+token_available (void *aux UNUSED) 
+{
+  return tokens > 0;
+}
+
+static bool
+go_set (void *aux UNUSED) 
+{
+  return go;
+}
+
+static bool
+never (void *aux UNUSED) 
+{
+  return false;
+}
+
+void
+test_priority_wait_queue (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  wait_queue_init (&wq);
+
+  thread_set_priority (PRI_MIN);
+  for (i = 0; i < 5; i++) 
+    {
+      int priority = PRI_DEFAULT - (i + 3) % 5 - 1;
+      char name[16];
+      snprintf (name, sizeof name, "priority %d", priority);
+      thread_create (name, priority, exclusive_thread, NULL);
+    }
+  for (i = 0; i < 3; i++) 
+    {
+      int priority = PRI_DEFAULT - (i + 2) % 3 - 6;
+      char name[16];
+      snprintf (name, sizeof name, "priority %d", priority);
+      thread_create (name, priority, shared_thread, NULL);
+    }
+
+  for (i = 0; i < 5; i++) 
+    {
+      tokens++;
+      msg ("Woke %d threads.", wake_up (&wq));
+    }
+
+  go = true;
+  msg ("Woke %d threads.", wake_up (&wq));
+
+  msg ("Waiting with a timeout...");
+  if (wait_event_timeout (&wq, never, NULL, true, 5))
+    fail ("wait_event_timeout() returned true");
+  msg ("Timed out.");
+}
+
+static void
+exclusive_thread (void *aux UNUSED) 
+{
+  msg ("Thread %s waiting exclusively.", thread_name ());
+  wait_event_exclusive (&wq, token_available, NULL);
+  tokens--;
+  msg ("Thread %s got a token.", thread_name ());
+}
+
+static void
+shared_thread (void *aux UNUSED) 
+{
+  msg ("Thread %s waiting.", thread_name ());
+  wait_event (&wq, go_set, NULL);
+  msg ("Thread %s woke up.", thread_name ());
+}
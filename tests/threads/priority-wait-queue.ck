@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-wait-queue) begin
+(priority-wait-queue) Thread priority 27 waiting exclusively.
+(priority-wait-queue) Thread priority 26 waiting exclusively.
+(priority-wait-queue) Thread priority 30 waiting exclusively.
+(priority-wait-queue) Thread priority 29 waiting exclusively.
+(priority-wait-queue) Thread priority 28 waiting exclusively.
+(priority-wait-queue) Thread priority 23 waiting.
+(priority-wait-queue) Thread priority 25 waiting.
+(priority-wait-queue) Thread priority 24 waiting.
+(priority-wait-queue) Thread priority 30 got a token.
+(priority-wait-queue) Woke 4 threads.
+(priority-wait-queue) Thread priority 29 got a token.
+(priority-wait-queue) Woke 4 threads.
+(priority-wait-queue) Thread priority 28 got a token.
+(priority-wait-queue) Woke 4 threads.
+(priority-wait-queue) Thread priority 27 got a token.
+(priority-wait-queue) Woke 4 threads.
+(priority-wait-queue) Thread priority 26 got a token.
+(priority-wait-queue) Woke 4 threads.
+(priority-wait-queue) Thread priority 25 woke up.
+(priority-wait-queue) Thread priority 24 woke up.
+(priority-wait-queue) Thread priority 23 woke up.
+(priority-wait-queue) Woke 3 threads.
+(priority-wait-queue) Waiting with a timeout...
+(priority-wait-queue) Timed out.
+(priority-wait-queue) end
+EOF
+pass;
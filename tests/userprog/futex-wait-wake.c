@@ -0,0 +1,48 @@
+/* Exercises futex_wait() and futex_wake() directly: waiting on a
+   value that doesn't match, waiting until a timeout, waking with
+   nobody asleep, and waking a thread asleep on the futex. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int futex;
+
+/* Sleeps on FUTEX, which stays 0, until futex_wake() wakes it. */
+static void
+sleeper (void *aux UNUSED)
+{
+  while (futex_wait (&futex, 0, -1) != 0)
+    continue;
+  thread_exit (0);
+}
+
+void
+test_main (void) 
+{
+  tid_t tid;
+  int woken;
+
+  futex = 1;
+  CHECK (futex_wait (&futex, 0, -1) == -1,
+         "futex_wait() on another value returns -1 at once");
+  CHECK (futex_wait (&futex, 1, 50) == -1,
+         "futex_wait() for 50 ms times out");
+  CHECK (futex_wake (&futex, 1) == 0, "futex_wake() with no sleepers wakes 0");
+
+  futex = 0;
+  tid = thread_create (sleeper, NULL, NULL);
+  if (tid == TID_ERROR)
+    fail ("thread_create() failed");
+
+  /* The sleeper may not be asleep yet: nap and try again. */
+  while ((woken = futex_wake (&futex, 1)) == 0)
+    {
+      int nap = 0;
+      futex_wait (&nap, 0, 10);
+    }
+  if (woken != 1)
+    fail ("futex_wake() returned %d", woken);
+  msg ("futex_wake() woke the sleeper");
+  CHECK (thread_join (tid) == 0, "the sleeper exited");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-wait-wake) begin
+(futex-wait-wake) futex_wait() on another value returns -1 at once
+(futex-wait-wake) futex_wait() for 50 ms times out
+(futex-wait-wake) futex_wake() with no sleepers wakes 0
+(futex-wait-wake) futex_wake() woke the sleeper
+(futex-wait-wake) the sleeper exited
+(futex-wait-wake) end
+futex-wait-wake: exit(0)
+EOF
+pass;
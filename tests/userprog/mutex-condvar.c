@@ -0,0 +1,100 @@
+/* Exercises the futex-based mutex and condition variable of
+   <mutex.h>.  Several threads increment a counter under a mutex
+   with a read-modify-write slow enough to be preempted in the
+   middle, then a producer hands values to a consumer one at a time
+   through a condition variable. */
+
+#include <mutex.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define INCREMENTS 20000
+#define ITEMS 100
+
+static struct mutex lock = MUTEX_INITIALIZER;
+static int counter;
+
+static void
+incrementer (void *aux UNUSED)
+{
+  int i, j;
+
+  for (i = 0; i < INCREMENTS; i++)
+    {
+      int old;
+
+      mutex_lock (&lock);
+      old = counter;
+      for (j = 0; j < 10; j++)
+        __atomic_signal_fence (__ATOMIC_SEQ_CST);
+      counter = old + 1;
+      mutex_unlock (&lock);
+    }
+  thread_exit (0);
+}
+
+/* One-slot mailbox between the producer and the consumer. */
+static struct condvar changed = CONDVAR_INITIALIZER;
+static bool full;
+static int slot;
+
+static void
+consumer (void *aux UNUSED)
+{
+  int i, sum = 0;
+
+  for (i = 0; i < ITEMS; i++)
+    {
+      mutex_lock (&lock);
+      while (!full)
+        condvar_wait (&changed, &lock);
+      sum += slot;
+      full = false;
+      condvar_signal (&changed);
+      mutex_unlock (&lock);
+    }
+  thread_exit (sum);
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  tid_t tid;
+  int i, sum = 0;
+
+  mutex_lock (&lock);
+  CHECK (!mutex_trylock (&lock), "mutex_trylock() of a held mutex fails");
+  mutex_unlock (&lock);
+  CHECK (mutex_trylock (&lock), "mutex_trylock() of a free mutex succeeds");
+  mutex_unlock (&lock);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (incrementer, NULL, NULL);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create() of incrementer %d failed", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_join (tids[i]);
+  CHECK (counter == THREAD_CNT * INCREMENTS, "counter is %d",
+         THREAD_CNT * INCREMENTS);
+
+  tid = thread_create (consumer, NULL, NULL);
+  if (tid == TID_ERROR)
+    fail ("thread_create() of consumer failed");
+  for (i = 1; i <= ITEMS; i++)
+    {
+      mutex_lock (&lock);
+      while (full)
+        condvar_wait (&changed, &lock);
+      slot = i;
+      full = true;
+      sum += i;
+      condvar_signal (&changed);
+      mutex_unlock (&lock);
+    }
+  CHECK (thread_join (tid) == sum, "consumer received all %d items", ITEMS);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mutex-condvar) begin
+(mutex-condvar) mutex_trylock() of a held mutex fails
+(mutex-condvar) mutex_trylock() of a free mutex succeeds
+(mutex-condvar) counter is 80000
+(mutex-condvar) consumer received all 100 items
+(mutex-condvar) end
+mutex-condvar: exit(0)
+EOF
+pass;
@@ -0,0 +1,107 @@
+/* Loads different values into the SSE registers of two processes
+   and spins in each while the timer switches between them, then
+   checks that each process still has its own values.  The child is
+   forked with the parent's values loaded, so it first checks that
+   fork() copied them. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define XMM_CNT 8
+#define SPINS 100000000
+
+typedef uint8_t xmm_regs[XMM_CNT][16];
+
+/* User programs are built with -mno-sse, so nothing but the asm
+   below touches the XMM registers between a load and a store. */
+static void
+load_xmm (const xmm_regs regs)
+{
+  asm volatile ("movdqu 0(%0), %%xmm0\n"
+                "movdqu 16(%0), %%xmm1\n"
+                "movdqu 32(%0), %%xmm2\n"
+                "movdqu 48(%0), %%xmm3\n"
+                "movdqu 64(%0), %%xmm4\n"
+                "movdqu 80(%0), %%xmm5\n"
+                "movdqu 96(%0), %%xmm6\n"
+                "movdqu 112(%0), %%xmm7\n"
+                : : "r" (regs) : "memory");
+}
+
+static void
+store_xmm (xmm_regs regs)
+{
+  asm volatile ("movdqu %%xmm0, 0(%0)\n"
+                "movdqu %%xmm1, 16(%0)\n"
+                "movdqu %%xmm2, 32(%0)\n"
+                "movdqu %%xmm3, 48(%0)\n"
+                "movdqu %%xmm4, 64(%0)\n"
+                "movdqu %%xmm5, 80(%0)\n"
+                "movdqu %%xmm6, 96(%0)\n"
+                "movdqu %%xmm7, 112(%0)\n"
+                : : "r" (regs) : "memory");
+}
+
+/* Busy-waits long enough for many timer ticks to preempt us. */
+static void
+spin (void)
+{
+  long cnt = SPINS;
+
+  asm volatile ("1: dec %0; jnz 1b" : "+r" (cnt));
+}
+
+static void
+fill (xmm_regs regs, int seed)
+{
+  int i, j;
+
+  for (i = 0; i < XMM_CNT; i++)
+    for (j = 0; j < 16; j++)
+      regs[i][j] = seed + i * 16 + j;
+}
+
+/* Spins with SEED's values in the XMM registers.  Returns true if
+   they are still there afterward. */
+static bool
+survives_switches (int seed)
+{
+  xmm_regs want, got;
+
+  fill (want, seed);
+  load_xmm (want);
+  spin ();
+  store_xmm (got);
+  return memcmp (want, got, sizeof want) == 0;
+}
+
+void
+test_main (void) 
+{
+  xmm_regs parent, got;
+  bool ok;
+  pid_t pid;
+
+  fill (parent, 0x10);
+  load_xmm (parent);
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      store_xmm (got);
+      CHECK (memcmp (parent, got, sizeof got) == 0,
+             "child inherited the parent's SSE registers");
+      CHECK (survives_switches (0x80), "child's SSE registers survived");
+      exit (0);
+    }
+  if (pid < 0)
+    fail ("fork() failed");
+
+  /* Report only after the child is done, to keep the output in
+     order. */
+  ok = survives_switches (0x40);
+  CHECK (wait (pid) == 0, "wait for child");
+  CHECK (ok, "parent's SSE registers survived");
+}
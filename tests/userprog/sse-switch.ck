@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sse-switch) begin
+(sse-switch) child inherited the parent's SSE registers
+(sse-switch) child's SSE registers survived
+child: exit(0)
+(sse-switch) wait for child
+(sse-switch) parent's SSE registers survived
+(sse-switch) end
+sse-switch: exit(0)
+EOF
+pass;
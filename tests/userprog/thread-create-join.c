@@ -0,0 +1,47 @@
+/* Starts several threads in one process, each of which adds its
+   number to a shared counter and exits with a status of its own,
+   then joins them all and checks the statuses and the counter. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 8
+
+static int counter;
+
+static void
+worker (void *aux)
+{
+  int i = (int) (long) aux;
+
+  __atomic_fetch_add (&counter, i, __ATOMIC_SEQ_CST);
+  thread_exit (100 + i);
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int i, sum = 0;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (worker, (void *) (long) i, NULL);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create() of thread %d failed", i);
+      sum += i;
+    }
+  msg ("created %d threads", THREAD_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int status = thread_join (tids[i]);
+      if (status != 100 + i)
+        fail ("thread %d exited with %d, not %d", i, status, 100 + i);
+    }
+  msg ("joined %d threads", THREAD_CNT);
+
+  CHECK (thread_join (tids[0]) == -1, "second join of a thread fails");
+  CHECK (counter == sum, "counter is %d", sum);
+}
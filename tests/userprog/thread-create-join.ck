@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-create-join) begin
+(thread-create-join) created 8 threads
+(thread-create-join) joined 8 threads
+(thread-create-join) second join of a thread fails
+(thread-create-join) counter is 28
+(thread-create-join) end
+thread-create-join: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Calls exec() while two other threads are alive, one spinning in
+   user mode and one asleep in futex_wait().  Both must be ended
+   and the new program must run as the only thread. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int never;
+
+static void
+spinner (void *aux UNUSED)
+{
+  for (;;)
+    continue;
+}
+
+static void
+sleeper (void *aux UNUSED)
+{
+  futex_wait (&never, 0, -1);
+  fail ("sleeper returned to user mode");
+}
+
+void
+test_main (void) 
+{
+  if (thread_create (spinner, NULL, NULL) == TID_ERROR
+      || thread_create (sleeper, NULL, NULL) == TID_ERROR)
+    fail ("thread_create() failed");
+  msg ("exec with two live threads");
+  exec ("child-simple");
+  fail ("exec() returned");
+}
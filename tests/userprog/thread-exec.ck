@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-exec) begin
+(thread-exec) exec with two live threads
+(child-simple) run
+thread-exec: exit(81)
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* A thread other than the leader calls exit(), which ends the
+   whole process with its status.  The leader, blocked joining a
+   thread that spins forever, must never get back to user mode,
+   and the spinner must be stopped too. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+spinner (void *aux UNUSED)
+{
+  for (;;)
+    continue;
+}
+
+static void
+exiter (void *aux UNUSED)
+{
+  exit (57);
+}
+
+void
+test_main (void) 
+{
+  tid_t spin;
+
+  spin = thread_create (spinner, NULL, NULL);
+  if (spin == TID_ERROR)
+    fail ("thread_create() of spinner failed");
+  msg ("leader joins the spinner");
+  if (thread_create (exiter, NULL, NULL) == TID_ERROR)
+    fail ("thread_create() of exiter failed");
+  thread_join (spin);
+  fail ("leader returned to user mode");
+}
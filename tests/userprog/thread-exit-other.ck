@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-exit-other) begin
+(thread-exit-other) leader joins the spinner
+thread-exit-other: exit(57)
+EOF
+pass;
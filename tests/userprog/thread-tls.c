@@ -0,0 +1,68 @@
+/* Gives each of several threads a TLS block of its own as its FS
+   base.  Each reads its block back through %fs over and over while
+   the threads preempt one another, so an FS base lost or mixed up
+   across a timer interrupt or a thread switch shows up as a wrong
+   value. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITERATIONS 20000000
+
+struct tls
+  {
+    int id;
+  };
+
+static struct tls blocks[THREAD_CNT];
+
+/* Returns the id in the calling thread's TLS block. */
+static int
+tls_id (void)
+{
+  int id;
+
+  asm volatile ("movl %%fs:0, %0" : "=r" (id));
+  return id;
+}
+
+/* Exits with the number of times the TLS block read wrong. */
+static void
+reader (void *aux)
+{
+  int id = (int) (long) aux;
+  int wrong = 0;
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++)
+    if (tls_id () != id)
+      wrong++;
+  thread_exit (wrong);
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      blocks[i].id = 1000 + i;
+      tids[i] = thread_create (reader, (void *) (long) blocks[i].id,
+                               &blocks[i]);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create() of thread %d failed", i);
+    }
+  msg ("started %d threads", THREAD_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int wrong = thread_join (tids[i]);
+      if (wrong != 0)
+        fail ("thread %d read its TLS wrong %d times", i, wrong);
+    }
+  msg ("every thread always saw its own TLS");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-tls) begin
+(thread-tls) started 4 threads
+(thread-tls) every thread always saw its own TLS
+(thread-tls) end
+thread-tls: exit(0)
+EOF
+pass;
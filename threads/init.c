@@ -8,7 +8,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "intrinsic.h"
 #include "devices/kbd.h"
+#include "devices/lapic.h"
 #include "devices/input.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
@@ -16,14 +18,19 @@
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
+#include "threads/lockstat.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/prof.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
+#include "userprog/fpu.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
@@ -87,6 +94,7 @@ main (void) { // loader.S 실행 후 메인 함수로 넘어옴
 	mem_end = palloc_init (); // palloc : page allocator 설정(초기화)
 	malloc_init (); // 사용자 메모리 할당(malloc함수)이 가능하게 설정(초기화)
 	paging_init (mem_end); // loader.S에서 구성했던 page table을 다시 구성(초기화).
+	lapic_init (); // local APIC 레지스터 매핑 (one-shot 타이머, EOI)
 
 #ifdef USERPROG
 	tss_init (); // tss(task state segment)를 설정한다. 이는 커널이 task를 관리할 때 필요한 정보가 들어있는 segment이다.
@@ -96,16 +104,20 @@ main (void) { // loader.S 실행 후 메인 함수로 넘어옴
 	/* Initialize interrupt handlers. 인터럽트 초기화 */ // 외부 인터럽트 - 핸들러로 초기화
 	intr_init (); // IDT(Interrupt Descriptor Table)를 초기화. 이 table은 인터럽트를 handling하는 handler 함수들이 연결되는 table이다.
 	timer_init (); // 타이머 인터럽트 초기화
+	prof_init (); // -prof: sample ring 할당
 	kbd_init (); // 키보드 인터럽트 초기화
 	input_init (); // input 모듈 초기화
 #ifdef USERPROG 
 	exception_init (); // 예외처리 인터럽트 초기화
+	fpu_init (); // 유저 프로그램의 FPU/SSE 사용 허용, #NM에서 lazy하게 state 교체
 	syscall_init (); // system call 인터럽트 초기화
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start (); // 우선 가장 실행 우선순위가 낮은 idle이라는 thread를 생성하여 동작시키고 인터럽트를 활성화시킨다
 	serial_init_queue (); // serial로부터 인터럽트를 받아 커널을 제어할 수 있도록 한다
 	timer_calibrate (); // 정확한 시간 측정을 위해 timer를 보정한다 //타이머 오차 안생기게 다시 재설정해주는 함수
+	workqueue_init (); // deferred work를 실행할 kworker thread pool 시작
+	palloc_zero_init (); // PAL_ZERO용 page를 미리 0으로 채워두는 work 시작
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -141,27 +153,97 @@ bss_init (void) {
 	memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CPUID feature bits for large pages.  2 MB pages (PSE) are part
+   of long mode, but 1 GB pages (PDPE1GB) are optional. */
+#define CPUID_1_EDX_PSE (1 << 3)
+#define CPUID_80000001_EDX_PDPE1GB (1 << 26)
+
+/* Returns true if physical memory [PA, PA + SIZE) can be mapped
+ * by a single large page in the direct map: both PA and its
+ * kernel virtual address must be SIZE-aligned, all of it must be
+ * below MEM_END, and it must not include any kernel text, which
+ * stays read-only in 4 kB pages.  The first megabyte, with the
+ * VGA hole and BIOS ROM, stays in 4 kB pages too: its MTRR memory
+ * types differ, which is undefined within one large page. */
+static bool
+direct_map_fits (uint64_t pa, uint64_t size, uint64_t mem_end) {
+	extern char start, _end_kernel_text;
+	uint64_t va = (uint64_t) ptov (pa);
+
+	return pa % size == 0 && va % size == 0 && pa + size <= mem_end
+		&& pa >= 0x100000
+		&& (va + size <= (uint64_t) &start
+			|| (uint64_t) &_end_kernel_text <= va);
+}
+
+/* Returns the PDPE (for SIZE == PDPE_PGSIZE) or PDE (for SIZE ==
+ * PDX_PGSIZE) that maps VA in PML4, creating the tables above it
+ * as needed. */
+static uint64_t *
+direct_map_slot (uint64_t *pml4, uint64_t va, uint64_t size) {
+	uint64_t *pdpt, *pd;
+
+	if (!(pml4[PML4 (va)] & PTE_P))
+		pml4[PML4 (va)] = vtop (palloc_get_page (PAL_ASSERT | PAL_ZERO))
+			| PTE_W | PTE_P;
+	pdpt = ptov (PTE_ADDR (pml4[PML4 (va)]));
+	if (size == PDPE_PGSIZE)
+		return &pdpt[PDPE (va)];
+
+	if (!(pdpt[PDPE (va)] & PTE_P))
+		pdpt[PDPE (va)] = vtop (palloc_get_page (PAL_ASSERT | PAL_ZERO))
+			| PTE_W | PTE_P;
+	pd = ptov (PTE_ADDR (pdpt[PDPE (va)]));
+	return &pd[PDX (va)];
+}
+
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ *
+ * The direct map uses 1 GB or 2 MB pages wherever they fit, so
+ * that kernel accesses to palloc'd memory take few TLB entries;
+ * pml4_create() shares these tables with every process. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
+	uint32_t eax, ebx, ecx, edx;
+	bool use_2mb, use_1gb = false;
 	int perm;
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	use_2mb = (edx & CPUID_1_EDX_PSE) != 0;
+	cpuid (0x80000000, &eax, &ebx, &ecx, &edx);
+	if (eax >= 0x80000001) {
+		cpuid (0x80000001, &eax, &ebx, &ecx, &edx);
+		use_1gb = (edx & CPUID_80000001_EDX_PDPE1GB) != 0;
+	}
+
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
 		perm = PTE_P | PTE_W;
+		if (use_1gb && direct_map_fits (pa, PDPE_PGSIZE, mem_end)) {
+			*direct_map_slot (pml4, va, PDPE_PGSIZE) = pa | PTE_PS | perm;
+			pa += PDPE_PGSIZE;
+			continue;
+		}
+		if (use_2mb && direct_map_fits (pa, PDX_PGSIZE, mem_end)) {
+			*direct_map_slot (pml4, va, PDX_PGSIZE) = pa | PTE_PS | perm;
+			pa += PDX_PGSIZE;
+			continue;
+		}
+
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		pa += PGSIZE;
 	}
 
 	// reload cr3
@@ -222,6 +304,16 @@ parse_options (char **argv) { // command line에서 options을 읽어온다.
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-schedlat"))
+			thread_schedlat = true;
+		else if (!strcmp (name, "-prof"))
+			prof_hz = atoi (value);
+		else if (!strcmp (name, "-lockstat"))
+			lockstat_enabled = true;
+		else if (!strcmp (name, "-zp"))
+			zero_page_limit = atoi (value);
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -329,6 +421,11 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -tickless          Stop the timer tick while idle.\n"
+			"  -schedlat          Print scheduler latency histograms.\n"
+			"  -prof=HZ           Sample RIP and call stack HZ times a second.\n"
+			"  -lockstat          Print lock contention statistics.\n"
+			"  -zp=COUNT          Keep COUNT zeroed pages ready per pool.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -357,6 +454,9 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	prof_print_stats ();
+	lockstat_print_stats ();
+	kmem_cache_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
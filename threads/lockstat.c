@@ -0,0 +1,165 @@
+#include "threads/lockstat.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "devices/timer.h"
+
+/* Lock contention statistics.
+
+   Under -lockstat, lock_init(), sema_init() and spinlock_init()
+   register each lock, semaphore and spinlock under its name,
+   which is the source text of the pointer it was initialized
+   through, such as "&filesys_lock", unless the caller passes a
+   better name.  Every object initialized with the same name
+   shares one class, so per-thread semaphores or per-inode locks
+   are counted together and never run out of classes.  Times are
+   measured with the TSC and reported in nanoseconds. */
+
+/* Maximum number of classes.  Later names go untracked. */
+#define LOCKSTAT_MAX 256
+
+/* Number of contended call sites kept per class. */
+#define LOCKSTAT_SITES 4
+
+/* Statistics for one class of locks, semaphores or spinlocks. */
+struct lock_stat {
+	const char *name;           /* Name given at initialization. */
+	bool is_lock;               /* Lock or spinlock, or semaphore? */
+	uint64_t acquired;          /* # of acquisitions or downs. */
+	uint64_t contended;         /* # of those that had to wait. */
+	uint64_t wait_total;        /* TSC cycles spent waiting. */
+	uint64_t wait_max;
+	uint64_t hold_total;        /* TSC cycles held, for locks. */
+	uint64_t hold_max;
+
+	/* Call sites that waited most often.  Kept with the
+	   "space-saving" scheme: a new site replaces the least
+	   frequent one and inherits its count, so frequent sites
+	   are never lost but counts may be overestimated. */
+	struct {
+		void *pc;
+		uint64_t count;
+	} sites[LOCKSTAT_SITES];
+};
+
+/* -lockstat. */
+bool lockstat_enabled;
+
+static struct lock_stat stats[LOCKSTAT_MAX];
+static int stat_cnt;
+static unsigned untracked;          /* # of names that found no room. */
+
+/* Returns the class for locks (if IS_LOCK) or semaphores called
+   NAME, creating it if necessary, or a null pointer if there is
+   no room for another. */
+struct lock_stat *
+lockstat_register (const char *name, bool is_lock) {
+	struct lock_stat *s = NULL;
+	enum intr_level old_level;
+	int i;
+
+	ASSERT (name != NULL);
+
+	old_level = intr_disable ();
+	for (i = 0; i < stat_cnt; i++)
+		if (stats[i].is_lock == is_lock
+				&& (stats[i].name == name || !strcmp (stats[i].name, name))) {
+			s = &stats[i];
+			break;
+		}
+	if (s == NULL) {
+		if (stat_cnt < LOCKSTAT_MAX) {
+			s = &stats[stat_cnt++];
+			s->name = name;
+			s->is_lock = is_lock;
+		} else
+			untracked++;
+	}
+	intr_set_level (old_level);
+
+	return s;
+}
+
+/* Records an acquisition in class S from call site SITE, which
+   waited WAIT TSC cycles if CONTENDED.  Interrupts must be off. */
+void
+lockstat_acquired (struct lock_stat *s, bool contended, uint64_t wait,
+		void *site) {
+	int i, min;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	s->acquired++;
+	if (!contended)
+		return;
+	s->contended++;
+	s->wait_total += wait;
+	if (s->wait_max < wait)
+		s->wait_max = wait;
+
+	for (i = min = 0; i < LOCKSTAT_SITES; i++) {
+		if (s->sites[i].pc == site) {
+			s->sites[i].count++;
+			return;
+		}
+		if (s->sites[i].count < s->sites[min].count)
+			min = i;
+	}
+	s->sites[min].pc = site;
+	s->sites[min].count++;
+}
+
+/* Records that a lock in class S was released after being held
+   HOLD TSC cycles.  Interrupts must be off. */
+void
+lockstat_released (struct lock_stat *s, uint64_t hold) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	s->hold_total += hold;
+	if (s->hold_max < hold)
+		s->hold_max = hold;
+}
+
+/* Prints every class that was used, most total wait time first,
+   with the call sites that waited for it most often.  The sites
+   are return addresses that `backtrace' can resolve. */
+void
+lockstat_print_stats (void) {
+	struct lock_stat *sorted[LOCKSTAT_MAX];
+	int i, j, cnt = 0;
+
+	if (!lockstat_enabled)
+		return;
+
+	for (i = 0; i < stat_cnt; i++) {
+		struct lock_stat *s = &stats[i];
+
+		if (s->acquired == 0)
+			continue;
+		for (j = cnt++; j > 0 && sorted[j - 1]->wait_total < s->wait_total; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = s;
+	}
+
+	printf ("Lock statistics, times in ns (%u names untracked):\n", untracked);
+	printf ("%-24s %10s %10s %12s %10s %12s %10s\n", "name", "acquired",
+			"contended", "wait total", "wait max", "hold total", "hold max");
+	for (i = 0; i < cnt; i++) {
+		struct lock_stat *s = sorted[i];
+
+		printf ("%-24s %10"PRIu64" %10"PRIu64" %12"PRIu64" %10"PRIu64,
+				s->name, s->acquired, s->contended,
+				timer_tsc_to_ns (s->wait_total), timer_tsc_to_ns (s->wait_max));
+		if (s->is_lock)
+			printf (" %12"PRIu64" %10"PRIu64"\n",
+					timer_tsc_to_ns (s->hold_total), timer_tsc_to_ns (s->hold_max));
+		else
+			printf (" %12s %10s\n", "-", "-");
+		for (j = 0; j < LOCKSTAT_SITES; j++)
+			if (s->sites[j].count != 0)
+				printf ("    waited at %p: %"PRIu64"\n",
+						s->sites[j].pc, s->sites[j].count);
+	}
+}
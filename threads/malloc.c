@@ -5,41 +5,73 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
-
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
+   The size of each request, in bytes, is rounded up to the next
+   "size class" and assigned to the "descriptor" that manages
+   blocks of that size.  Size classes are 16, 32, and 48 bytes and
+   then four per power of 2 (64, 80, 96, 112, 128, 160, ...), up
+   to 4 kB, so that rounding wastes at most 20% of a block.  The
+   descriptor keeps a list of free blocks.  If the free list is
+   nonempty, one of its blocks is used to satisfy the request.
+
+   Otherwise, a new run of memory, called an "arena", is obtained
+   from the page allocator (if none is available, malloc() returns
+   a null pointer).  Arenas for small blocks are one page, but
+   those for larger blocks span up to ARENA_MAX_PAGES pages, so
+   that their blocks fit without much left over.  The new arena is
+   divided into blocks, all of which are added to the descriptor's
+   free list.  Then we return one of the new blocks.  Each page
+   of an arena records the arena as its owner with the page
+   allocator, so that free() can find the arena of a block.
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   In front of its free list, each descriptor keeps a "magazine"
+   of up to MAG_SIZE free blocks for this CPU, but no more than
+   about a page's worth, which it fills and empties half at a
+   time.  The magazine is accessed
+   with interrupts off instead of under the descriptor's lock, so
+   most calls to malloc() and free() never take the lock and never
+   sleep.
+
+   We handle blocks bigger than 4 kB by allocating contiguous
+   pages with the page allocator and sticking the allocation size
+   at the beginning of the allocated block's arena header. */
+
+/* Largest magazine capacity. */
+#define MAG_SIZE 16
+
+/* Largest arena, in pages. */
+#define ARENA_MAX_PAGES 8
+
+/* Largest size class, in bytes. */
+#define CLASS_MAX 4096
+
+/* Free blocks cached for this CPU. */
+struct magazine {
+	int cnt;                    /* Number of blocks in `blocks'. */
+	int max;                    /* Capacity, at most MAG_SIZE. */
+	void *blocks[MAG_SIZE];     /* Free blocks, most recent last. */
+};
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
+	size_t arena_pages;         /* Number of pages in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+	char name[16];              /* Name of `lock' for -lockstat. */
+	struct magazine mag;        /* Protected by disabling interrupts. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -58,25 +90,132 @@ struct block {
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[32];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Descriptor for each request size, in units of 16 bytes. */
+static uint8_t class_of[CLASS_MAX / 16 + 1];
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
+/* Adds a descriptor for blocks of BLOCK_SIZE bytes, with arenas
+   large enough that less than 1/16 of each is left over. */
+static void
+add_desc (size_t block_size) {
+	struct desc *d = &descs[desc_cnt++];
+	size_t pages;
+
+	ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+
+	for (pages = 1; pages < ARENA_MAX_PAGES; pages *= 2)
+		if ((pages * PGSIZE - sizeof (struct arena)) % block_size
+				<= pages * PGSIZE / 16)
+			break;
+	d->block_size = block_size;
+	d->arena_pages = pages;
+	d->blocks_per_arena = (pages * PGSIZE - sizeof (struct arena)) / block_size;
+	list_init (&d->free_list);
+	snprintf (d->name, sizeof d->name, "malloc %zu", block_size);
+	lock_init_named (&d->lock, d->name);
+	d->mag.cnt = 0;
+	d->mag.max = PGSIZE / block_size;
+	if (d->mag.max < 2)
+		d->mag.max = 2;
+	if (d->mag.max > MAG_SIZE)
+		d->mag.max = MAG_SIZE;
+}
+
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
-
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
+	size_t block_size, pow, i;
+
+	for (block_size = 16; block_size < 64; block_size += 16)
+		add_desc (block_size);
+	for (pow = 64; pow < CLASS_MAX; pow *= 2)
+		for (i = 0; i < 4; i++)
+			add_desc (pow + i * pow / 4);
+	add_desc (CLASS_MAX);
+
+	for (i = 0, block_size = 0; block_size <= CLASS_MAX; block_size += 16) {
+		while (descs[i].block_size < block_size)
+			i++;
+		class_of[block_size / 16] = i;
+	}
+}
+
+/* Returns the BLOCK_CNT blocks in BLOCKS to D's free list, freeing
+   each arena that becomes unused. */
+static void
+put_blocks (struct desc *d, void **blocks, int block_cnt) {
+	int i;
+
+	lock_acquire (&d->lock);
+	for (i = 0; i < block_cnt; i++) {
+		struct block *b = blocks[i];
+		struct arena *a = block_to_arena (b);
+
+		/* Add block to free list. */
+		list_push_front (&d->free_list, &b->free_elem);
+
+		/* If the arena is now entirely unused, free it. */
+		if (++a->free_cnt >= d->blocks_per_arena) {
+			size_t j;
+
+			ASSERT (a->free_cnt == d->blocks_per_arena);
+			for (j = 0; j < d->blocks_per_arena; j++) {
+				struct block *b = arena_to_block (a, j);
+				list_remove (&b->free_elem);
+			}
+			palloc_free_multiple (a, d->arena_pages);
+		}
 	}
+	lock_release (&d->lock);
+}
+
+/* Takes up to BLOCK_CNT blocks from D's free list, creating a new
+   arena if it is empty, and stores them in BLOCKS.  Returns the
+   number taken, which is 0 only if memory is not available. */
+static int
+get_blocks (struct desc *d, void **blocks, int block_cnt) {
+	int i;
+
+	lock_acquire (&d->lock);
+
+	/* If the free list is empty, create a new arena. */
+	if (list_empty (&d->free_list)) {
+		struct arena *a;
+		size_t j;
+
+		/* Allocate its pages. */
+		a = palloc_get_multiple (0, d->arena_pages);
+		if (a == NULL) {
+			lock_release (&d->lock);
+			return 0;
+		}
+		for (j = 0; j < d->arena_pages; j++)
+			palloc_set_owner ((uint8_t *) a + j * PGSIZE, a);
+
+		/* Initialize arena and add its blocks to the free list. */
+		a->magic = ARENA_MAGIC;
+		a->desc = d;
+		a->free_cnt = d->blocks_per_arena;
+		for (j = 0; j < d->blocks_per_arena; j++) {
+			struct block *b = arena_to_block (a, j);
+			list_push_back (&d->free_list, &b->free_elem);
+		}
+	}
+
+	/* Get blocks from free list. */
+	for (i = 0; i < block_cnt && !list_empty (&d->free_list); i++) {
+		struct block *b = list_entry (list_pop_front (&d->free_list),
+				struct block, free_elem);
+		block_to_arena (b)->free_cnt--;
+		blocks[i] = b;
+	}
+	lock_release (&d->lock);
+	return i;
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -84,25 +223,24 @@ malloc_init (void) {
 void *
 malloc (size_t size) {
 	struct desc *d;
-	struct block *b;
 	struct arena *a;
+	enum intr_level old_level;
+	void *batch[MAG_SIZE / 2];
+	void *b;
+	int cnt;
 
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
 		return NULL;
 
-	/* Find the smallest descriptor that satisfies a SIZE-byte
-	   request. */
-	for (d = descs; d < descs + desc_cnt; d++)
-		if (d->block_size >= size)
-			break;
-	if (d == descs + desc_cnt) {
+	if (size > CLASS_MAX) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
 		a = palloc_get_multiple (0, page_cnt);
 		if (a == NULL)
 			return NULL;
+		palloc_set_owner (a, a);
 
 		/* Initialize the arena to indicate a big block of PAGE_CNT
 		   pages, and return it. */
@@ -112,34 +250,34 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
-
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
-
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
-		}
-
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
-		}
+	/* Find the smallest descriptor that satisfies a SIZE-byte
+	   request. */
+	d = &descs[class_of[DIV_ROUND_UP (size, 16)]];
+	ASSERT (d->block_size >= size);
+
+	/* Fast path: take a block from the magazine. */
+	old_level = intr_disable ();
+	if (d->mag.cnt > 0) {
+		b = d->mag.blocks[--d->mag.cnt];
+		intr_set_level (old_level);
+		return b;
 	}
+	intr_set_level (old_level);
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
-	lock_release (&d->lock);
+	/* Refill the magazine from the free list, keeping one block for
+	   ourselves.  Another thread may have refilled it meanwhile, so
+	   give back what doesn't fit. */
+	cnt = get_blocks (d, batch, d->mag.max / 2);
+	if (cnt == 0)
+		return NULL;
+	b = batch[--cnt];
+
+	old_level = intr_disable ();
+	while (cnt > 0 && d->mag.cnt < d->mag.max)
+		d->mag.blocks[d->mag.cnt++] = batch[--cnt];
+	intr_set_level (old_level);
+	if (cnt > 0)
+		put_blocks (d, batch, cnt);
 	return b;
 }
 
@@ -207,30 +345,30 @@ free (void *p) {
 
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
+			enum intr_level old_level;
+			void *batch[MAG_SIZE / 2];
+			int cnt = 0;
 
 #ifndef NDEBUG
 			/* Clear the block to help detect use-after-free bugs. */
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+			/* Put the block in the magazine, first emptying the
+			   older half of it to the free list if it is full. */
+			old_level = intr_disable ();
+			if (d->mag.cnt == d->mag.max) {
+				cnt = d->mag.max / 2;
+				memcpy (batch, d->mag.blocks, cnt * sizeof *batch);
+				memmove (d->mag.blocks, d->mag.blocks + cnt,
+						(d->mag.cnt - cnt) * sizeof *d->mag.blocks);
+				d->mag.cnt -= cnt;
 			}
+			d->mag.blocks[d->mag.cnt++] = b;
+			intr_set_level (old_level);
 
-			lock_release (&d->lock);
+			if (cnt > 0)
+				put_blocks (d, batch, cnt);
 		} else {
 			/* It's a big block.  Free its pages. */
 			palloc_free_multiple (a, a->free_cnt);
@@ -238,11 +376,11 @@ free (void *p) {
 		}
 	}
 }
-
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
+	struct arena *a = palloc_get_owner (pg_round_down (b));
 
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
@@ -250,7 +388,8 @@ block_to_arena (struct block *b) {
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+			|| ((uint8_t *) b - (uint8_t *) a - sizeof *a)
+			% a->desc->block_size == 0);
 	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
 	return a;
@@ -9,6 +9,30 @@
 #include "intrinsic.h"
 /* pml4 : Page Map Level 4단계 */
 
+/* Replaces *ENTRY, a large page mapping SIZE bytes, by a table of
+ * 512 entries that map the same memory with the same permissions
+ * in pieces of SIZE / 512 bytes, so that part of it can be mapped
+ * differently.  paging_init() maps the kernel's direct map with
+ * large pages, and its tables are shared by every pml4, so this
+ * flushes the TLB.  Returns false if out of memory. */
+static bool
+split_large_page (uint64_t *entry, uint64_t size) {
+	uint64_t *table = palloc_get_page (0);
+	uint64_t pa = PTE_ADDR (*entry);
+	uint64_t flags = *entry & PTE_FLAGS & ~PTE_PS;
+
+	if (table == NULL)
+		return false;
+	size /= 512;
+	if (size > PGSIZE)
+		flags |= PTE_PS;
+	for (unsigned i = 0; i < 512; i++)
+		table[i] = (pa + i * size) | flags;
+	*entry = vtop (table) | PTE_U | PTE_W | PTE_P;
+	lcr3 (rcr3 ());
+	return true;
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
@@ -23,6 +47,10 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 					return NULL;
 			} else
 				return NULL;
+		} else if (pdp[idx] & PTE_PS) {
+			/* 2 MB page: there is no PTE unless we split it. */
+			if (!create || !split_large_page (&pdp[idx], PDX_PGSIZE))
+				return NULL;
 		}
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
@@ -46,6 +74,10 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 					return NULL;
 			} else
 				return NULL;
+		} else if (pdpe[idx] & PTE_PS) {
+			/* 1 GB page. */
+			if (!create || !split_large_page (&pdpe[idx], PDPE_PGSIZE))
+				return NULL;
 		}
 		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create);
 	}
@@ -125,7 +157,14 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((pdp[i] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			/* A 2 MB page is itself the leaf entry. */
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -138,7 +177,13 @@ pdp_for_each (uint64_t *pdp,
 		pte_for_each_func *func, void *aux, unsigned pml4_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pde) & PTE_P)
+		if ((pdp[i] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			/* Likewise a 1 GB page. */
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) i << PDPESHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pde) & PTE_P)
 			if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
 					 aux, pml4_index, i))
 				return false;
@@ -146,7 +191,9 @@ pdp_for_each (uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * Large pages of the kernel's direct map are passed as a single
+ * entry, with PTE_PS set, for the address they start at. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
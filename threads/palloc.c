@@ -1,7 +1,7 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -9,8 +9,11 @@
 #include <string.h>
 #include "threads/init.h"
 #include "threads/loader.h"
+#include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -24,13 +27,52 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Its free memory is kept
+   as blocks of 1 << ORDER pages, for ORDER up to PALLOC_MAX_ORDER,
+   each aligned to its own size, on one free list per order.  An
+   allocation splits the smallest block that fits, and a free
+   merges a block with its buddy, the other half of the next larger
+   block, as long as that is free too.  Both take O(log n) steps
+   however fragmented the pool is.
+
+   Free blocks are tracked in a page_info array instead of in the
+   free pages themselves, because palloc_init() runs before
+   paging_init() maps all of RAM.
+
+   Each pool also keeps up to zero_page_limit pages zeroed ahead of
+   time by low-priority deferred work, so that a PAL_ZERO request
+   for one page need not zero it itself.  The pages stay allocated
+   while in this "zero pool", linked through their first word, and
+   are handed back to the buddy allocator when it runs out, as are
+   the thread pages and fd tables cached by thread.c.  The
+   kernel pool's serves the page tables that pml4e_walk() creates
+   and user processes' fd tables; the user pool's serves user stacks
+   without VM and zero-filled anonymous frames with it.  Thread
+   pages are not requested with PAL_ZERO: init_thread() clears only
+   the struct thread at their bottom. */
+
+/* Per-page state. */
+struct page_info {
+	union {
+		struct list_elem elem;      /* Free: in its pool's free_lists[order]. */
+		void *owner;                /* Allocated: see palloc_set_owner(). */
+	};
+	uint8_t order;                  /* Block order, if free. */
+	bool free;                      /* Head of a free block? */
+};
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct spinlock lock;           /* Mutual exclusion. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t page_cnt;                /* Pages in pool, holes included. */
+	struct page_info *pages;        /* One per page. */
+	struct list free_lists[PALLOC_MAX_ORDER + 1]; /* Free blocks. */
+	void *zero_pages;               /* First pre-zeroed page, or null. */
+	size_t zero_cnt;                /* Number of pre-zeroed pages. */
+	struct work zero_work;          /* Refills the zero pool. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,10 +80,18 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Number of pages to keep zeroed ahead of time in each pool. */
+size_t zero_page_limit = 32;
+
+/* Set once the workqueue can refill the zero pools. */
+static bool zero_pools_ready;
 static void
-init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
+init_pool (struct pool *p, const char *name, void **bm_base, uint64_t start,
+		uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -158,7 +208,7 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 						break;
 					}
 					// generate kernel pool
-					init_pool (&kernel_pool,
+					init_pool (&kernel_pool, "kernel pool",
 							&free_start, region_start, start + rem * PGSIZE);
 					// Transition to the next state
 					if (rem == size_in_pg) {
@@ -188,7 +238,7 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 	}
 
 	// generate the user pool
-	init_pool(&user_pool, &free_start, region_start, end);
+	init_pool(&user_pool, "user pool", &free_start, region_start, end);
 
 	// Iterate over the e820_entry. Setup the usable.
 	uint64_t usable_bound = (uint64_t) free_start;
@@ -219,16 +269,16 @@ split:
 			else
 				NOT_REACHED ();
 
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
+			pool_end = pool->base + pool->page_cnt * PGSIZE;
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_range (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_range (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -253,6 +303,266 @@ palloc_init (void) {
 	return ext_mem.end;
 }
 
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static unsigned
+order_for (size_t page_cnt) {
+	unsigned order = 0;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Puts the free block of 1 << ORDER pages at PAGE_IDX in POOL on
+   its free list. */
+static void
+push_block (struct pool *pool, size_t page_idx, unsigned order) {
+	struct page_info *pi = &pool->pages[page_idx];
+
+	pi->order = order;
+	pi->free = true;
+	list_push_front (&pool->free_lists[order], &pi->elem);
+}
+
+/* Takes the free block at PAGE_INFO off its free list. */
+static void
+pull_block (struct page_info *pi) {
+	list_remove (&pi->elem);
+	pi->free = false;
+}
+
+/* Allocates a block of 1 << ORDER pages from POOL, splitting a
+   larger block if there is no free one that size.  Returns its
+   page index, or SIZE_MAX if POOL has no block large enough. */
+static size_t
+alloc_block (struct pool *pool, unsigned order) {
+	unsigned o;
+
+	for (o = order; o <= PALLOC_MAX_ORDER; o++)
+		if (!list_empty (&pool->free_lists[o]))
+			break;
+	if (o > PALLOC_MAX_ORDER)
+		return SIZE_MAX;
+
+	struct page_info *pi = list_entry (list_front (&pool->free_lists[o]),
+			struct page_info, elem);
+	size_t page_idx = pi - pool->pages;
+
+	pull_block (pi);
+	/* Give back the upper halves we don't need. */
+	while (o > order) {
+		o--;
+		push_block (pool, page_idx + ((size_t) 1 << o), o);
+	}
+	return page_idx;
+}
+
+/* Allocates PAGE_CNT pages, more than one block holds, from POOL
+   as a run of adjacent free blocks of the largest order.  Slow,
+   but only needed for allocations of more than 4 MB.  Returns the
+   page index of the run, or SIZE_MAX if there is none. */
+static size_t
+alloc_large (struct pool *pool, size_t page_cnt) {
+	const size_t block_pages = (size_t) 1 << PALLOC_MAX_ORDER;
+	size_t block_cnt = DIV_ROUND_UP (page_cnt, block_pages);
+	struct list *list = &pool->free_lists[PALLOC_MAX_ORDER];
+	struct list_elem *e;
+
+	for (e = list_begin (list); e != list_end (list); e = list_next (e)) {
+		size_t page_idx = list_entry (e, struct page_info, elem) - pool->pages;
+		size_t i;
+
+		if (page_idx + block_cnt * block_pages > pool->page_cnt)
+			continue;
+		for (i = 1; i < block_cnt; i++) {
+			struct page_info *pi = &pool->pages[page_idx + i * block_pages];
+			if (!pi->free || pi->order != PALLOC_MAX_ORDER)
+				break;
+		}
+		if (i < block_cnt)
+			continue;
+
+		for (i = 0; i < block_cnt; i++)
+			pull_block (&pool->pages[page_idx + i * block_pages]);
+		free_range (pool, page_idx + page_cnt,
+				block_cnt * block_pages - page_cnt);
+		return page_idx;
+	}
+	return SIZE_MAX;
+}
+
+/* Frees the block of 1 << ORDER pages at PAGE_IDX in POOL,
+   merging it with its buddy for as long as that is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, unsigned order) {
+	size_t base_no = pg_no (pool->base);
+
+	ASSERT (!pool->pages[page_idx].free);
+
+	for (; order < PALLOC_MAX_ORDER; order++) {
+		size_t buddy_no = (base_no + page_idx) ^ ((size_t) 1 << order);
+		size_t buddy_idx;
+		struct page_info *buddy;
+
+		if (buddy_no < base_no)
+			break;
+		buddy_idx = buddy_no - base_no;
+		if (buddy_idx + ((size_t) 1 << order) > pool->page_cnt)
+			break;
+		buddy = &pool->pages[buddy_idx];
+		if (!buddy->free || buddy->order != order)
+			break;
+
+		pull_block (buddy);
+		if (buddy_idx < page_idx)
+			page_idx = buddy_idx;
+	}
+	push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, which need not be
+   one block: they are freed as the largest aligned blocks that
+   make them up. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t base_no = pg_no (pool->base);
+
+	while (page_cnt > 0) {
+		unsigned order = 0;
+
+		while (order < PALLOC_MAX_ORDER
+				&& (base_no + page_idx) % ((size_t) 2 << order) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Allocates PAGE_CNT pages from POOL and returns the page index
+   of the first, or SIZE_MAX if POOL has no run that long.  POOL's
+   lock must be held. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt) {
+	size_t page_idx;
+
+	if (page_cnt > (size_t) 1 << PALLOC_MAX_ORDER)
+		return alloc_large (pool, page_cnt);
+
+	unsigned order = order_for (page_cnt);
+
+	page_idx = alloc_block (pool, order);
+	/* Keep only what was asked for. */
+	if (page_idx != SIZE_MAX)
+		free_range (pool, page_idx + page_cnt,
+				((size_t) 1 << order) - page_cnt);
+	return page_idx;
+}
+
+/* Takes a page off POOL's zero pool, which must not be empty, and
+   returns its page index.  POOL's lock must be held. */
+static size_t
+zero_pool_pop (struct pool *pool) {
+	void **page = pool->zero_pages;
+
+	pool->zero_pages = *page;
+	*page = NULL;
+	pool->zero_cnt--;
+	return pg_no (page) - pg_no (pool->base);
+}
+
+/* Gives every page in POOL's zero pool back to the buddy
+   allocator, because POOL is out of memory.  POOL's lock must be
+   held. */
+static void
+zero_pool_drain (struct pool *pool) {
+	while (pool->zero_pages != NULL)
+		free_block (pool, zero_pool_pop (pool), 0);
+}
+
+/* Asks the caches that keep freed kernel pages outside palloc to
+   give them back, because POOL is out of memory.  Returns true if
+   any page came back, so that the allocation is worth retrying.
+   POOL's lock must not be held. */
+static bool
+pool_shrink (struct pool *pool) {
+	return pool == &kernel_pool && thread_shrink_caches ();
+}
+
+/* Queues the refill of POOL's zero pool if it has fallen below
+   half of zero_page_limit.  queue_work() may start a worker
+   thread, so this is skipped with interrupts off, as when
+   allocating in the scheduler. */
+static void
+zero_pool_kick (struct pool *pool) {
+	if (zero_pools_ready && pool->zero_cnt < zero_page_limit / 2
+			&& intr_get_level () == INTR_ON && !intr_context ())
+		queue_work (&pool->zero_work);
+}
+
+/* Fills PAGE with zeros using non-temporal stores, which go
+   straight to memory instead of evicting useful cache lines: the
+   page will not be touched until someone allocates it. */
+static void
+zero_page_nt (void *page) {
+	uint64_t *p = page;
+
+	for (size_t i = 0; i < PGSIZE / sizeof *p; i += 4)
+		asm volatile ("movnti %1, (%0)\n\t"
+				"movnti %1, 8(%0)\n\t"
+				"movnti %1, 16(%0)\n\t"
+				"movnti %1, 24(%0)"
+				: : "r" (p + i), "r" (0ULL) : "memory");
+	/* Order the stores before the page is published. */
+	asm volatile ("sfence" : : : "memory");
+}
+
+/* Work function: zeroes free pages of AUX, a struct pool, into its
+   zero pool until it holds zero_page_limit pages or the pool runs
+   out of memory. */
+static void
+zero_pool_fill (void *aux) {
+	struct pool *pool = aux;
+
+	for (;;) {
+		size_t page_idx;
+		void **page;
+
+		spinlock_acquire (&pool->lock);
+		page_idx = pool->zero_cnt < zero_page_limit
+			? alloc_block (pool, 0) : SIZE_MAX;
+		spinlock_release (&pool->lock);
+		if (page_idx == SIZE_MAX)
+			break;
+
+		page = (void **) (pool->base + PGSIZE * page_idx);
+		zero_page_nt (page);
+
+		spinlock_acquire (&pool->lock);
+		*page = pool->zero_pages;
+		pool->zero_pages = page;
+		pool->zero_cnt++;
+		spinlock_release (&pool->lock);
+	}
+}
+
+/* Lets the zero pools be filled.  Called once the workqueue is up. */
+void
+palloc_zero_init (void) {
+	if (zero_page_limit == 0)
+		return;
+
+	work_init (&kernel_pool.zero_work, WORK_PRI_LOW, zero_pool_fill,
+			&kernel_pool);
+	work_init (&user_pool.zero_work, WORK_PRI_LOW, zero_pool_fill,
+			&user_pool);
+	/* A pool is first filled when somebody asks it for a zeroed
+	   page, so one that nobody does, such as the user pool under
+	   VM, never ties up any pages. */
+	zero_pools_ready = true;
+}
+
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
@@ -261,20 +571,43 @@ palloc_init (void) {
    FLAGS, in which case the kernel panics. */
 void * palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	size_t page_idx;
+	bool zeroed = false;
+	bool shrunk = false;
 	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
+	if (page_cnt == 0)
+		return NULL;
+
+retry:
+	spinlock_acquire (&pool->lock);
+	if (page_cnt == 1 && (flags & PAL_ZERO) && pool->zero_pages != NULL) {
+		page_idx = zero_pool_pop (pool);
+		zeroed = true;
+	} else {
+		page_idx = alloc_pages (pool, page_cnt);
+		if (page_idx == SIZE_MAX && pool->zero_cnt > 0) {
+			zero_pool_drain (pool);
+			page_idx = alloc_pages (pool, page_cnt);
+		}
+	}
+	spinlock_release (&pool->lock);
+	if (page_idx == SIZE_MAX && !shrunk) {
+		shrunk = true;
+		if (pool_shrink (pool))
+			goto retry;
+	}
+
+	if (page_idx != SIZE_MAX)
 		pages = pool->base + PGSIZE * page_idx;
 	else
 		pages = NULL;
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset (pages, 0, PGSIZE * page_cnt);
+		if ((flags & PAL_ZERO) && page_cnt == 1)
+			zero_pool_kick (pool);
 	} else {
 		if (flags & PAL_ASSERT)
 			PANIC ("palloc_get: out of pages");
@@ -283,6 +616,43 @@ void * palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	return pages;
 }
 
+/* Obtains a block of 1 << ORDER contiguous free pages, aligned to
+   its own size in physical memory, as palloc_get_multiple() does.
+   Free it with palloc_free_multiple (block, 1 << ORDER). */
+void *
+palloc_get_block (enum palloc_flags flags, unsigned order) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t page_idx;
+	bool shrunk = false;
+	void *block;
+
+	ASSERT (order <= PALLOC_MAX_ORDER);
+
+retry:
+	spinlock_acquire (&pool->lock);
+	page_idx = alloc_block (pool, order);
+	if (page_idx == SIZE_MAX && pool->zero_cnt > 0) {
+		zero_pool_drain (pool);
+		page_idx = alloc_block (pool, order);
+	}
+	spinlock_release (&pool->lock);
+	if (page_idx == SIZE_MAX && !shrunk) {
+		shrunk = true;
+		if (pool_shrink (pool))
+			goto retry;
+	}
+
+	if (page_idx == SIZE_MAX) {
+		if (flags & PAL_ASSERT)
+			PANIC ("palloc_get: out of pages");
+		return NULL;
+	}
+	block = pool->base + PGSIZE * page_idx;
+	if (flags & PAL_ZERO)
+		memset (block, 0, PGSIZE << order);
+	return block;
+}
+
 /* Obtains a single free page and returns its kernel virtual address.
    If PAL_USER is set, the page is obtained from the user pool, otherwise from the kernel pool.  
    If PAL_ZERO is set in FLAGS, then the page is filled with zeros.  
@@ -315,12 +685,14 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 		NOT_REACHED ();
 
 	page_idx = pg_no (pages) - pg_no (pool->base);
+	ASSERT (page_idx + page_cnt <= pool->page_cnt);
 
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
-	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	spinlock_acquire (&pool->lock);
+	free_range (pool, page_idx, page_cnt);
+	spinlock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -329,23 +701,62 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END */
+/* Returns the page_info of PAGE, which must be in a pool. */
+static struct page_info *
+page_to_info (const void *page) {
+	struct pool *pool;
+
+	if (page_from_pool (&kernel_pool, (void *) page))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, (void *) page))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+	return &pool->pages[pg_no (page) - pg_no (pool->base)];
+}
+
+/* Records OWNER as the owner of allocated page PAGE, for
+   palloc_get_owner().  The page allocator itself does not use it,
+   and forgets it when the page is freed. */
+void
+palloc_set_owner (void *page, void *owner) {
+	struct page_info *pi = page_to_info (page);
+
+	ASSERT (!pi->free);
+	pi->owner = owner;
+}
+
+/* Returns the owner last set for allocated page PAGE by
+   palloc_set_owner(). */
+void *
+palloc_get_owner (const void *page) {
+	return page_to_info (page)->owner;
+}
+
+/* Initializes pool P as starting at START and ending at END.
+   NAME names its lock for -lockstat. */
 static void
-init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+init_pool (struct pool *p, const char *name, void **bm_base, uint64_t start,
+		uint64_t end) {
+  /* We'll put the pool's page_info array at its base.
+     Calculate the space needed for it
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t pi_size = DIV_ROUND_UP (pgcnt * sizeof *p->pages, PGSIZE) * PGSIZE;
 
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	spinlock_init_named (&p->lock, name);
 	p->base = (void *) start;
+	p->page_cnt = pgcnt;
+	p->pages = *bm_base;
+	p->zero_pages = NULL;
+	p->zero_cnt = 0;
+	for (int order = 0; order <= PALLOC_MAX_ORDER; order++)
+		list_init (&p->free_lists[order]);
 
 	// Mark all to unusable.
-	bitmap_set_all(p->used_map, true);
+	memset (p->pages, 0, pi_size);
 
-	*bm_base += bm_pages;
+	*bm_base += pi_size;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -354,6 +765,6 @@ static bool
 page_from_pool (const struct pool *pool, void *page) {
 	size_t page_no = pg_no (page);
 	size_t start_page = pg_no (pool->base);
-	size_t end_page = start_page + bitmap_size (pool->used_map);
+	size_t end_page = start_page + pool->page_cnt;
 	return page_no >= start_page && page_no < end_page;
 }
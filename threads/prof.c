@@ -0,0 +1,169 @@
+#include "threads/prof.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#ifdef USERPROG
+#include "threads/mmu.h"
+#endif
+
+/* Sampling profiler.
+
+   Every few timer interrupts, prof_sample() records where the
+   interrupted code was: its RIP followed by the return addresses
+   found by following saved frame pointers, the running thread's
+   tid, and whether it was in user or kernel mode.  Samples go
+   into a ring allocated once at boot, so that taking one never
+   allocates, and the newest PROF_PAGES worth are printed at power
+   off, one per line:
+
+       prof tid=3 kernel: 0xffffffff80209c3b 0xffffffff8020a1d2 ...
+
+   The addresses can be passed to `backtrace', or the whole output
+   to `prof-fold', which symbolizes and counts the stacks in the
+   "collapsed" format that flame graph tools read. */
+
+/* Number of addresses kept per sample, RIP included. */
+#define PROF_DEPTH 8
+
+/* Number of pages in the sample ring. */
+#define PROF_PAGES 16
+
+/* One sample. */
+struct prof_sample {
+	uint64_t pc[PROF_DEPTH];    /* Interrupted RIP, then callers. */
+	tid_t tid;                  /* Running thread. */
+	uint8_t depth;              /* # of valid entries in `pc'. */
+	bool user;                  /* Interrupted in user mode? */
+};
+
+#define PROF_SAMPLES (PROF_PAGES * PGSIZE / sizeof (struct prof_sample))
+
+/* -prof=HZ. */
+int prof_hz;
+
+static struct prof_sample *ring;    /* PROF_SAMPLES samples, or null. */
+static uint64_t sample_cnt;         /* # of samples ever taken. */
+static unsigned interval;           /* Timer ticks between samples. */
+static unsigned countdown;          /* Ticks until the next sample. */
+
+static int backtrace_kernel (uint64_t *pc, int max, uint64_t rbp,
+		uint64_t rsp);
+#ifdef USERPROG
+static int backtrace_user (uint64_t *pc, int max, uint64_t rbp);
+#endif
+
+/* Allocates the sample ring if the profiler was asked for.  The
+   timer interrupt samples at most once per tick, so a rate above
+   TIMER_FREQ is lowered to it. */
+void
+prof_init (void) {
+	if (prof_hz <= 0)
+		return;
+	if (prof_hz > TIMER_FREQ)
+		prof_hz = TIMER_FREQ;
+
+	ring = palloc_get_multiple (PAL_ZERO, PROF_PAGES);
+	if (ring == NULL) {
+		printf ("prof: no memory for %d pages, profiling disabled\n",
+				PROF_PAGES);
+		return;
+	}
+	interval = countdown = TIMER_FREQ / prof_hz;
+}
+
+/* Records a sample of the code interrupted by timer interrupt
+   frame F, if one is due.  Called with interrupts off. */
+void
+prof_sample (const struct intr_frame *f) {
+	struct prof_sample *s;
+
+	if (ring == NULL || --countdown > 0)
+		return;
+	countdown = interval;
+
+	s = &ring[sample_cnt++ % PROF_SAMPLES];
+	s->tid = thread_current ()->tid;
+	s->user = (f->cs & 3) == 3;
+	s->pc[0] = f->rip;
+	s->depth = 1;
+	if (!s->user)
+		s->depth += backtrace_kernel (s->pc + 1, PROF_DEPTH - 1,
+				f->R.rbp, f->rsp);
+#ifdef USERPROG
+	else
+		s->depth += backtrace_user (s->pc + 1, PROF_DEPTH - 1, f->R.rbp);
+#endif
+}
+
+/* Prints every sample still in the ring, oldest first. */
+void
+prof_print_stats (void) {
+	uint64_t first, i;
+
+	if (ring == NULL)
+		return;
+
+	first = sample_cnt > PROF_SAMPLES ? sample_cnt - PROF_SAMPLES : 0;
+	printf ("Profile: %"PRIu64" samples at %d Hz, %"PRIu64" overwritten\n",
+			sample_cnt, prof_hz, first);
+	for (i = first; i < sample_cnt; i++) {
+		const struct prof_sample *s = &ring[i % PROF_SAMPLES];
+
+		printf ("prof tid=%d %s:", s->tid, s->user ? "user" : "kernel");
+		for (int d = 0; d < s->depth; d++)
+			printf (" %#"PRIx64, s->pc[d]);
+		printf ("\n");
+	}
+}
+
+/* Stores in PC up to MAX return addresses found by following
+   kernel frame pointers from RBP, and returns how many.  Frames
+   must stay within the kernel stack page that RSP points into
+   and move toward its top, so a corrupt chain cannot fault. */
+static int
+backtrace_kernel (uint64_t *pc, int max, uint64_t rbp, uint64_t rsp) {
+	uint64_t top = (uint64_t) pg_round_down (rsp) + PGSIZE;
+	int n = 0;
+
+	while (n < max && rbp >= rsp && rbp <= top - 16 && rbp % 8 == 0) {
+		const uint64_t *frame = (const uint64_t *) rbp;
+
+		if (frame[1] == 0)
+			break;
+		pc[n++] = frame[1];
+		if (frame[0] <= rbp)
+			break;
+		rbp = frame[0];
+	}
+	return n;
+}
+
+#ifdef USERPROG
+/* Like backtrace_kernel(), but follows the running process's
+   frame pointers through its page table, stopping at the first
+   frame that is not mapped in. */
+static int
+backtrace_user (uint64_t *pc, int max, uint64_t rbp) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	int n = 0;
+
+	if (pml4 == NULL)
+		return 0;
+	while (n < max && is_user_vaddr ((void *) rbp) && rbp != 0
+			&& rbp % 16 == 0) {
+		const uint64_t *frame = pml4_get_page (pml4, (void *) rbp);
+
+		if (frame == NULL || frame[1] == 0)
+			break;
+		pc[n++] = frame[1];
+		if (frame[0] <= rbp)
+			break;
+		rbp = frame[0];
+	}
+	return n;
+}
+#endif
@@ -0,0 +1,338 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator for fixed-size objects.
+
+   malloc() rounds each request up to one of its size classes,
+   wasting up to a fifth of a block, and mixes objects of every
+   type in its arenas.  Code that allocates many objects of one
+   type instead creates a kmem_cache for it, which packs the
+   objects tightly into page-size "slabs".
+
+   Each slab starts with a struct slab header and keeps its free
+   objects on a singly linked list threaded through them.  A cache
+   keeps the slabs that have free objects on its `partial' list,
+   and gives a slab back to the page allocator once all of its
+   objects are free, unless it is the cache's last partial slab.
+
+   In front of the slabs, each cache keeps up to KMEM_HOT_CNT
+   recently freed objects in its `hot' array, so that in the common
+   case an allocation or a free is a pointer pop or push.  Freed
+   objects come out first, while still in the CPU cache.  Like
+   malloc()'s magazines, the array is accessed with interrupts off
+   instead of under the cache's lock, which is only taken to refill
+   it from the slabs or drain half of it back to them.
+
+   The space a slab has left over after its objects is used to
+   "colour" it: successive slabs start their objects at different
+   multiples of the cache line size, so that objects at the same
+   index in different slabs do not all compete for the same cache
+   sets.
+
+   A cache may have a constructor, run on each object when its slab
+   is created.  Objects must be freed in their constructed state,
+   so such a cache keeps each free object's link after the object
+   instead of in it. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Colour offsets are multiples of this. */
+#define CACHE_LINE 64
+
+/* Objects are aligned to this. */
+#define OBJ_ALIGN 8
+
+/* Maximum number of caches, for statistics. */
+#define CACHE_MAX 32
+
+/* Slab header, at the start of each slab's page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	uint8_t *objs;              /* First object, after the colour. */
+	size_t inuse;               /* Objects allocated or in `hot'. */
+	void *free;                 /* First free object. */
+	struct list_elem elem;      /* Element in the cache's `partial'. */
+};
+
+/* Every cache, for kmem_cache_print_stats(). */
+static struct kmem_cache *caches[CACHE_MAX];
+static int cache_cnt;
+
+static struct slab *obj_to_slab (struct kmem_cache *, void *obj);
+
+/* Returns the address of the link in free object OBJ of C. */
+static inline void **
+obj_link (struct kmem_cache *c, void *obj) {
+	return (void **) ((uint8_t *) obj + c->link_ofs);
+}
+
+/* Creates and returns a cache of objects of SIZE bytes named NAME,
+   whose objects are set up by CTOR if it is not null.  Panics if
+   memory is not available: caches are created at boot. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor) {
+	struct kmem_cache *c;
+	size_t hdr = ROUND_UP (sizeof (struct slab), OBJ_ALIGN);
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		PANIC ("kmem_cache_create: out of memory");
+
+	c->name = name;
+	c->obj_size = size;
+	c->ctor = ctor;
+	if (size < sizeof (void *))
+		size = sizeof (void *);
+	size = ROUND_UP (size, OBJ_ALIGN);
+	c->link_ofs = ctor != NULL ? size : 0;
+	c->stride = ctor != NULL ? size + sizeof (void *) : size;
+	c->objs_per_slab = (PGSIZE - hdr) / c->stride;
+	ASSERT (c->objs_per_slab >= 8);
+	c->colour_cnt = (PGSIZE - hdr - c->objs_per_slab * c->stride)
+		/ CACHE_LINE + 1;
+	c->colour_next = 0;
+
+	lock_init_named (&c->lock, name);
+	list_init (&c->partial);
+	c->hot_cnt = 0;
+	c->alloc_cnt = c->free_cnt = c->hot_hits = 0;
+	c->slab_cnt = c->slab_max = 0;
+
+	if (cache_cnt < CACHE_MAX)
+		caches[cache_cnt++] = c;
+	return c;
+}
+
+/* Adds a new slab to C's partial list.  Returns false if memory is
+   not available.  C's lock must be held. */
+static bool
+slab_grow (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	uint8_t *obj;
+	size_t i;
+
+	if (s == NULL)
+		return false;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->inuse = 0;
+	s->free = NULL;
+	s->objs = (uint8_t *) s + ROUND_UP (sizeof *s, OBJ_ALIGN)
+		+ c->colour_next * CACHE_LINE;
+	c->colour_next = (c->colour_next + 1) % c->colour_cnt;
+
+	/* Link the objects lowest address first. */
+	obj = s->objs + c->objs_per_slab * c->stride;
+	for (i = 0; i < c->objs_per_slab; i++) {
+		obj -= c->stride;
+		if (c->ctor != NULL)
+			c->ctor (obj);
+		*obj_link (c, obj) = s->free;
+		s->free = obj;
+	}
+
+	list_push_front (&c->partial, &s->elem);
+	if (++c->slab_cnt > c->slab_max)
+		c->slab_max = c->slab_cnt;
+	return true;
+}
+
+/* Returns OBJ to its slab in C, and the slab to the page allocator
+   if it is now unused and not C's last partial slab.  C's lock
+   must be held. */
+static void
+slab_put (struct kmem_cache *c, void *obj) {
+	struct slab *s = obj_to_slab (c, obj);
+
+	ASSERT (s->inuse > 0);
+
+	if (s->free == NULL)
+		list_push_front (&c->partial, &s->elem);
+	*obj_link (c, obj) = s->free;
+	s->free = obj;
+
+	if (--s->inuse == 0
+			&& list_begin (&c->partial) != list_rbegin (&c->partial)) {
+		list_remove (&s->elem);
+		s->magic = 0;
+		palloc_free_page (s);
+		c->slab_cnt--;
+	}
+}
+
+/* Moves up to CNT objects from C's slabs into BATCH, growing C
+   if it has no partial slab, and returns the number moved, which
+   is 0 only if memory is not available. */
+static size_t
+slab_get_batch (struct kmem_cache *c, void **batch, size_t cnt) {
+	size_t got = 0;
+
+	lock_acquire (&c->lock);
+	while (got < cnt) {
+		struct slab *s;
+
+		if (list_empty (&c->partial) && !slab_grow (c))
+			break;
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+		batch[got++] = s->free;
+		s->free = *obj_link (c, s->free);
+		s->inuse++;
+		if (s->free == NULL)
+			list_remove (&s->elem);
+	}
+	lock_release (&c->lock);
+	return got;
+}
+
+/* Returns the CNT objects in BATCH to their slabs in C. */
+static void
+slab_put_batch (struct kmem_cache *c, void **batch, size_t cnt) {
+	lock_acquire (&c->lock);
+	while (cnt > 0)
+		slab_put (c, batch[--cnt]);
+	lock_release (&c->lock);
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	enum intr_level old_level;
+	void *batch[KMEM_HOT_CNT / 2];
+	size_t cnt;
+	void *obj;
+
+	ASSERT (c != NULL);
+
+	/* Fast path: take the most recently freed object. */
+	old_level = intr_disable ();
+	if (c->hot_cnt > 0) {
+		obj = c->hot[--c->hot_cnt];
+		c->hot_hits++;
+		c->alloc_cnt++;
+		intr_set_level (old_level);
+		return obj;
+	}
+	intr_set_level (old_level);
+
+	/* Refill `hot' from the slabs, keeping one object for
+	   ourselves.  Another thread may have refilled it meanwhile, so
+	   give back what doesn't fit. */
+	cnt = slab_get_batch (c, batch, KMEM_HOT_CNT / 2);
+	if (cnt == 0)
+		return NULL;
+	obj = batch[--cnt];
+
+	old_level = intr_disable ();
+	while (cnt > 0 && c->hot_cnt < KMEM_HOT_CNT)
+		c->hot[c->hot_cnt++] = batch[--cnt];
+	c->alloc_cnt++;
+	intr_set_level (old_level);
+	if (cnt > 0)
+		slab_put_batch (c, batch, cnt);
+	return obj;
+}
+
+/* Obtains an object from cache C, which must not have a
+   constructor, and fills it with zeros.  Returns a null pointer if
+   memory is not available. */
+void *
+kmem_cache_zalloc (struct kmem_cache *c) {
+	void *obj;
+
+	ASSERT (c->ctor == NULL);
+
+	obj = kmem_cache_alloc (c);
+	if (obj != NULL)
+		memset (obj, 0, c->obj_size);
+	return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to C.
+   A null OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	enum intr_level old_level;
+	void *batch[KMEM_HOT_CNT / 2];
+	size_t cnt = 0;
+
+	ASSERT (c != NULL);
+
+	if (obj == NULL)
+		return;
+	obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->obj_size);
+#endif
+
+	/* Put the object in `hot', first taking the older half of it
+	   back to the slabs if it is full. */
+	old_level = intr_disable ();
+	if (c->hot_cnt == KMEM_HOT_CNT) {
+		cnt = KMEM_HOT_CNT / 2;
+		memcpy (batch, c->hot, cnt * sizeof *batch);
+		memmove (c->hot, c->hot + cnt, (c->hot_cnt - cnt) * sizeof *c->hot);
+		c->hot_cnt -= cnt;
+	}
+	c->hot[c->hot_cnt++] = obj;
+	c->free_cnt++;
+	intr_set_level (old_level);
+
+	if (cnt > 0)
+		slab_put_batch (c, batch, cnt);
+}
+
+/* Prints statistics about every cache that has been used. */
+void
+kmem_cache_print_stats (void) {
+	int i;
+
+	if (cache_cnt == 0)
+		return;
+
+	printf ("Slab statistics:\n");
+	printf ("%-20s %6s %5s %12s %12s %12s %6s %6s\n", "name", "size", "/slab",
+			"allocs", "frees", "hot hits", "slabs", "max");
+	for (i = 0; i < cache_cnt; i++) {
+		struct kmem_cache *c = caches[i];
+
+		if (c->alloc_cnt == 0)
+			continue;
+		printf ("%-20s %6zu %5zu %12"PRIu64" %12"PRIu64" %12"PRIu64
+				" %6zu %6zu\n", c->name, c->obj_size, c->objs_per_slab,
+				c->alloc_cnt, c->free_cnt, c->hot_hits, c->slab_cnt, c->slab_max);
+	}
+}
+
+/* Returns the slab that OBJ of cache C is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	/* Check that the slab is valid and belongs to C. */
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+
+	/* Check that the object is properly aligned for the slab. */
+	ASSERT ((uint8_t *) obj >= s->objs);
+	ASSERT (((uint8_t *) obj - s->objs) % c->stride == 0);
+
+	return s;
+}
@@ -30,25 +30,21 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/lockstat.h"
 #include "threads/thread.h"
-
-bool thread_compare_priority (struct list_elem *l, struct list_elem *s, void *aux UNUSED);
-
-/* Donate 추가 */
-bool thread_compare_donate_priority (const struct list_elem *l, const struct list_elem *s, void *aux UNUSED);
-
-/* PROJECT1: THREADS - Priority Scheduling */
-
-bool sema_compare_priority (const struct list_elem *l, const struct list_elem *s, void *aux UNUSED){
-	struct semaphore_elem *l_sema = list_entry (l, struct semaphore_elem, elem);
-	struct semaphore_elem *s_sema = list_entry (s, struct semaphore_elem, elem);
-
-	struct list *waiter_l_sema = &(l_sema->semaphore.waiters);
-	struct list *waiter_s_sema = &(s_sema->semaphore.waiters);
-
-	return list_entry (list_begin (waiter_l_sema), struct thread, elem)->priority
-		 > list_entry (list_begin (waiter_s_sema), struct thread, elem)->priority;
-}
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+static bool sema_waiter_more (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+static bool cond_waiter_more (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+static void waiter_push (struct heap *, struct heap_elem *);
+static bool lock_donor_more (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+static void donation_update (struct thread *);
+static void rwlock_donation_changed (struct rwlock *);
+static int rwlock_donation (const struct rwlock *);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -58,13 +54,19 @@ bool sema_compare_priority (const struct list_elem *l, const struct list_elem *s
    decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-   thread, if any). */
+   thread, if any).
+
+   Under -lockstat, downs are counted under NAME unless it is a
+   null pointer.  Call this through the sema_init() macro, which
+   names SEMA after its source text. */
 void
-sema_init (struct semaphore *sema, unsigned value) {
+sema_init_named (struct semaphore *sema, unsigned value, const char *name) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	heap_init (&sema->waiters, sema_waiter_more, NULL);
+	sema->stat = lockstat_enabled && name != NULL
+		? lockstat_register (name, false) : NULL;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -80,17 +82,25 @@ sema_init (struct semaphore *sema, unsigned value) {
 void
 sema_down (struct semaphore *sema) {
 	enum intr_level old_level;
+	bool contended = false;
+	uint64_t start = 0;
 
 	ASSERT (sema != NULL);
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
+	if (sema->stat != NULL) {
+		contended = sema->value == 0;
+		start = rdtsc ();
+	}
 	while (sema->value == 0) {
-		// list_push_back (&sema->waiters, &thread_current ()->elem); // 주석 처리
-		list_insert_ordered (&sema->waiters, &thread_current ()->elem, thread_compare_priority, 0); // waiter에 스레드를 넣어줄 때 우선순위를 고려하여 넣을 수 있도록
+		waiter_push (&sema->waiters, &thread_current ()->wait_elem); // 우선순위 heap에 넣는다
 		thread_block ();
 	}
 	sema->value--;
+	if (sema->stat != NULL)
+		lockstat_acquired (sema->stat, contended, rdtsc () - start,
+				__builtin_return_address (0));
 	intr_set_level (old_level);
 }
 
@@ -126,10 +136,10 @@ sema_try_down (struct semaphore *sema) {
    SEMA를 기다리는 사람들의 실타래가 있다면 깨워줍니다.
    이 함수는 인터럽트 핸들러에서 호출할 수 있다. */
 
-/* sema_up( ) 함수의 경우, waiters 리스트에 있는 동안 우선순위의 변동이 있을 수 있다.
-	따라서, thread_unblock( ) 함수를 호출하기 전에 해당 리스트를 내림차순으로 정렬할 수 있도록 한다.
+/* sema_up( ) 함수의 경우, waiters heap에 있는 동안 우선순위의 변동이 있을 수 있다.
+	thread_update_priority( )가 그때마다 heap 안의 위치를 고쳐 주므로, 정렬 없이 heap의 top을 깨우면 된다.
 	그런데 unblock 된 스레드가 현재 CPU를 점유하고 있는 스레드보다 우선순위가 높을 수 있다.
-	thread_test_preemption( ) 함수를 실행하여 CPU를 점유할 수 있도록 한다. */
+	preempt_by_priority( ) 함수를 실행하여 CPU를 점유할 수 있도록 한다. */
 
 /* Priority Scheduling 수정 */
 void
@@ -141,10 +151,13 @@ sema_up (struct semaphore *sema) {
 	old_level = intr_disable ();
 
 	/* ----------- project1 ------------ */
-	if (!list_empty (&sema->waiters)){
-		list_sort(&sema->waiters, &thread_priority_compare, 0);
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
+	if (!heap_empty (&sema->waiters)){
+		struct thread *t = heap_entry (heap_pop (&sema->waiters),
+				struct thread, wait_elem);
+
+		if (t->wait_heap == &sema->waiters)
+			t->wait_heap = NULL;
+		thread_unblock (t);
 	}
 	/* --------------------------------- */
 
@@ -211,13 +224,20 @@ sema_test_helper (void *sema_) {
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   Under -lockstat, acquisitions are counted under NAME.  Call
+   this through the lock_init() macro, which names LOCK after its
+   source text. */
 void
-lock_init (struct lock *lock) {
+lock_init_named (struct lock *lock, const char *name) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
-	sema_init (&lock->semaphore, 1); // 1로 초기화 -> xmutex로 사용하겠다는 이야기
+	sema_init_named (&lock->semaphore, 1, NULL); // 1로 초기화 -> xmutex로 사용하겠다는 이야기
+	heap_init (&lock->donors, lock_donor_more, NULL);
+	lock->stat = lockstat_enabled ? lockstat_register (name, true) : NULL;
+	lock->acquire_tsc = 0;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -230,27 +250,51 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	bool contended;
+	uint64_t start = 0;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
+	contended = lock->semaphore.value == 0;
+	if (lock->stat != NULL)
+		start = rdtsc ();
 
 	/* ----------- Project 1 ------------ */
-	struct thread *curr = thread_current();
-	
-	if (lock->holder) {
+	/* 기다리는 동안 lock의 donors에 들어가 holder에게 priority를 준다. */
+	if (lock->holder != NULL && !thread_mlfqs) {
 		curr->wait_on_lock = lock;
-		list_push_back(&lock->holder->donation_list, &curr->donation_elem);
-		donate_priority();
+		heap_push (&lock->donors, &curr->donor_elem);
+		heap_update (&lock->holder->held_locks, &lock->held_elem);
+		donation_update (lock->holder);
 	}
 	/* ---------------------------------- */
-	
+
 	sema_down (&lock->semaphore);
 
 	/* ----------- Project 1 ------------ */
-	curr->wait_on_lock = NULL;
+	/* 남은 donors는 이제 새 holder인 curr에게 donate한다. */
+	if (curr->wait_on_lock != NULL) {
+		heap_remove (&lock->donors, &curr->donor_elem);
+		curr->wait_on_lock = NULL;
+	}
 	lock->holder = curr;
+	if (!thread_mlfqs) {
+		heap_push (&curr->held_locks, &lock->held_elem);
+		donation_update (curr);
+	}
 	/* ---------------------------------- */
+
+	if (lock->stat != NULL) {
+		lock->acquire_tsc = rdtsc ();
+		lockstat_acquired (lock->stat, contended, lock->acquire_tsc - start,
+				__builtin_return_address (0));
+	}
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false on failure.
@@ -259,14 +303,30 @@ lock_acquire (struct lock *lock) {
    This function will not sleep, so it may be called within an interrupt handler. */
 bool
 lock_try_acquire (struct lock *lock) {
+	enum intr_level old_level;
 	bool success;
 
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
 	success = sema_try_down (&lock->semaphore);
-	if (success)
-		lock->holder = thread_current ();
+	if (success) {
+		struct thread *curr = thread_current ();
+
+		lock->holder = curr;
+		/* A woken waiter may still be queued as a donor. */
+		if (!thread_mlfqs) {
+			heap_push (&curr->held_locks, &lock->held_elem);
+			donation_update (curr);
+		}
+		if (lock->stat != NULL) {
+			lock->acquire_tsc = rdtsc ();
+			lockstat_acquired (lock->stat, false, 0,
+					__builtin_return_address (0));
+		}
+	}
+	intr_set_level (old_level);
 	return success;
 }
 
@@ -278,16 +338,27 @@ lock_try_acquire (struct lock *lock) {
    handler. */
 void
 lock_release (struct lock *lock) {
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
+	if (lock->stat != NULL)
+		lockstat_released (lock->stat, rdtsc () - lock->acquire_tsc);
+
 	/* ----------- Project 1 ------------ */
-	remove_donation_list_elem(lock);
-	reset_priority();
+	/* The MLFQS does not donate priority.  Dropping LOCK from
+	   held_locks takes its donors' priority back in O(log n). */
+	if (!thread_mlfqs) {
+		heap_remove (&lock->holder->held_locks, &lock->held_elem);
+		donation_update (lock->holder);
+	}
 	/* ---------------------------------- */
 
 	lock->holder = NULL;
 	sema_up (&lock->semaphore);
+	intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -300,12 +371,6 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
-};
-
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -313,7 +378,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	heap_init (&cond->waiters, cond_waiter_more, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -339,15 +404,23 @@ cond_init (struct condition *cond) {
 void
 cond_wait (struct condition *cond, struct lock *lock) {
 	struct semaphore_elem waiter;
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	sema_init (&waiter.semaphore, 0);
-	// list_push_back (&cond->waiters, &waiter.elem);
-	list_insert_ordered (&cond->waiters, &waiter.elem, sema_compare_priority, 0);
+	/* Not counted under -lockstat: registering costs a scan of
+	   every class, and WAITER lives only for this call. */
+	sema_init_named (&waiter.semaphore, 0, NULL);
+	waiter.thread = thread_current ();
+
+	/* Queued from here on, so releasing LOCK below, or any later
+	   donation, repositions WAITER in COND's heap. */
+	old_level = intr_disable ();
+	waiter_push (&cond->waiters, &waiter.elem);
+	intr_set_level (old_level);
 
 	lock_release (lock);
 
@@ -371,10 +444,19 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	/* ----------- Project 1 ------------ */
-	if (!list_empty (&cond->waiters))
-		list_sort(&cond->waiters, &sema_priority_compare, NULL);
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+	struct semaphore_elem *waiter = NULL;
+	enum intr_level old_level = intr_disable ();
+
+	if (!heap_empty (&cond->waiters)) {
+		waiter = heap_entry (heap_pop (&cond->waiters),
+				struct semaphore_elem, elem);
+		if (waiter->thread->wait_heap == &cond->waiters)
+			waiter->thread->wait_heap = NULL;
+	}
+	intr_set_level (old_level);
+
+	if (waiter != NULL)
+		sema_up (&waiter->semaphore);
 	/* ---------------------------------- */
 }
 
@@ -389,72 +471,727 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!heap_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
 
+/* One thread in wait_event_common().  Lives on its stack. */
+struct wait_entry {
+	struct list_elem elem;      /* Element in the queue's `waiters'. */
+	struct thread *thread;      /* The waiting thread. */
+	bool exclusive;             /* Woken only one at a time? */
+	bool queued;                /* In `waiters'? */
+	bool woken;                 /* Dequeued by a wake_up()? */
+	bool blocked;               /* In thread_block_until()? */
+};
+
+/* Initializes WQ as empty. */
+void
+wait_queue_init (struct wait_queue *wq) {
+	ASSERT (wq != NULL);
+
+	list_init (&wq->waiters);
+}
+
+/* Returns true if any thread waits on WQ, so that a caller can skip
+   wake_up() otherwise. */
+bool
+wait_queue_active (struct wait_queue *wq) {
+	return !list_empty (&wq->waiters);
+}
+
+/* Sleeps on WQ until COND (AUX) returns true or, unless UNTIL is
+   INT64_MAX, until timer tick UNTIL.  If LOCK is not null, the
+   caller holds it, COND is checked under it, and it is released
+   while sleeping.  Returns true if COND returned true. */
+static bool
+wait_event_common (struct wait_queue *wq, wait_cond_func *cond, void *aux,
+		bool exclusive, int64_t until, struct lock *lock) {
+	struct wait_entry w;
+	enum intr_level old_level;
+	bool done;
+
+	ASSERT (wq != NULL);
+	ASSERT (cond != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (lock == NULL || lock_held_by_current_thread (lock));
+
+	w.thread = thread_current ();
+	w.exclusive = exclusive;
+	w.queued = w.blocked = false;
+
+	for (;;) {
+		/* Queue up before checking COND, so that a wake_up() right
+		   after the check is not lost. */
+		old_level = intr_disable ();
+		if (!w.queued) {
+			if (exclusive)
+				list_push_back (&wq->waiters, &w.elem);
+			else
+				list_push_front (&wq->waiters, &w.elem);
+			w.queued = true;
+			w.woken = false;
+		}
+		intr_set_level (old_level);
+
+		done = cond (aux);
+		if (done || until <= timer_ticks ())
+			break;
+
+		if (lock != NULL)
+			lock_release (lock);
+		old_level = intr_disable ();
+		if (!w.woken) {
+			w.blocked = true;
+			thread_block_until (until);
+			w.blocked = false;
+		}
+		intr_set_level (old_level);
+		if (lock != NULL)
+			lock_acquire (lock);
+	}
+
+	old_level = intr_disable ();
+	if (w.queued)
+		list_remove (&w.elem);
+	intr_set_level (old_level);
+
+	/* An exclusive wakeup we took but did not use is owed to the
+	   next exclusive waiter. */
+	if (exclusive && w.woken && !done)
+		wake_up (wq);
+	return done;
+}
+
+/* Sleeps on WQ, as a non-exclusive waiter, until COND (AUX)
+   returns true.  COND is checked with no lock held, so it must only
+   read state that its wakers update before waking WQ.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+wait_event (struct wait_queue *wq, wait_cond_func *cond, void *aux) {
+	wait_event_common (wq, cond, aux, false, INT64_MAX, NULL);
+}
+
+/* Like wait_event(), but as an exclusive waiter. */
+void
+wait_event_exclusive (struct wait_queue *wq, wait_cond_func *cond,
+		void *aux) {
+	wait_event_common (wq, cond, aux, true, INT64_MAX, NULL);
+}
+
+/* Like wait_event() or, if EXCLUSIVE, wait_event_exclusive(), but
+   gives up after TICKS timer ticks.  Returns true if COND (AUX)
+   returned true, false on timeout. */
+bool
+wait_event_timeout (struct wait_queue *wq, wait_cond_func *cond, void *aux,
+		bool exclusive, int64_t ticks) {
+	return wait_event_common (wq, cond, aux, exclusive,
+			timer_ticks () + (ticks > 0 ? ticks : 0), NULL);
+}
+
+/* Like wait_event(), but for state protected by LOCK, which the
+   caller must hold: COND is checked under LOCK, and LOCK is
+   released while sleeping and held again on return. */
+void
+wait_event_lock (struct wait_queue *wq, wait_cond_func *cond, void *aux,
+		struct lock *lock) {
+	ASSERT (lock != NULL);
+
+	wait_event_common (wq, cond, aux, false, INT64_MAX, lock);
+}
+
+/* Dequeues waiter W of WQ and makes it runnable.  Interrupts must
+   be off. */
+static void
+wake_entry (struct wait_entry *w) {
+	list_remove (&w->elem);
+	w->queued = false;
+	w->woken = true;
+	/* A waiter whose timeout just expired is ready already. */
+	if (w->blocked && w->thread->status == THREAD_BLOCKED)
+		thread_wake (w->thread);
+}
+
+/* Wakes the waiters of WQ: every non-exclusive one and, unless
+   ALL, only the highest-priority exclusive one.  Returns the
+   number woken. */
+static int
+wake_common (struct wait_queue *wq, bool all) {
+	struct wait_entry *best = NULL;
+	struct list_elem *e;
+	enum intr_level old_level;
+	int woken = 0;
+
+	ASSERT (wq != NULL);
+
+	old_level = intr_disable ();
+	for (e = list_begin (&wq->waiters); e != list_end (&wq->waiters); ) {
+		struct wait_entry *w = list_entry (e, struct wait_entry, elem);
+
+		e = list_next (e);
+		if (w->exclusive && !all) {
+			/* Exclusive waiters are queued FIFO at the back. */
+			if (best == NULL || w->thread->priority > best->thread->priority)
+				best = w;
+			continue;
+		}
+		wake_entry (w);
+		woken++;
+	}
+	if (best != NULL) {
+		wake_entry (best);
+		woken++;
+	}
+
+	if (woken > 0 && preempt_by_priority ()) {
+		if (intr_context ())
+			intr_yield_on_return ();
+		else
+			thread_yield ();
+	}
+	intr_set_level (old_level);
+	return woken;
+}
+
+/* Wakes every non-exclusive waiter of WQ and the highest-priority
+   exclusive one, which then recheck their conditions.  Returns the
+   number of threads woken.
+
+   This function may be called from an interrupt handler. */
+int
+wake_up (struct wait_queue *wq) {
+	return wake_common (wq, false);
+}
+
+/* Wakes every waiter of WQ, exclusive or not.  Returns the number
+   of threads woken.
+
+   This function may be called from an interrupt handler. */
+int
+wake_up_all (struct wait_queue *wq) {
+	return wake_common (wq, true);
+}
+
+/* Initializes RW as an unheld reader-writer lock. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	rw->writer = NULL;
+	rw->readers = 0;
+	list_init (&rw->holders);
+	heap_init (&rw->read_waiters, sema_waiter_more, NULL);
+	heap_init (&rw->write_waiters, sema_waiter_more, NULL);
+}
+
+/* Returns the current thread's hold on RW, or a free hold if RW is
+   null, or a null pointer if there is none.  Only a thread itself
+   takes and drops its holds, so this needs no interrupts off. */
+static struct rwlock_hold *
+rwlock_hold_find (const struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+	int i;
+
+	for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+		if (curr->rwlock_holds[i].rwlock == rw)
+			return &curr->rwlock_holds[i];
+	return NULL;
+}
+
+/* Records that the current thread now holds RW and takes on the
+   priority RW's waiters donate.  If all its holds are in use, the
+   hold is only counted, and gets no donations.  Interrupts must be
+   off. */
+static void
+rwlock_hold (struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+	struct rwlock_hold *hold;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	hold = rwlock_hold_find (NULL);
+	if (hold == NULL) {
+		curr->rwlock_overflow++;
+		return;
+	}
+	hold->rwlock = rw;
+	hold->thread = curr;
+	list_push_back (&rw->holders, &hold->elem);
+	if (!thread_mlfqs) {
+		heap_push (&curr->held_rwlocks, &hold->held_elem);
+		donation_update (curr);
+	}
+}
+
+/* Records that the current thread no longer holds RW.  Interrupts
+   must be off. */
+static void
+rwlock_unhold (struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+	struct rwlock_hold *hold = rwlock_hold_find (rw);
+
+	if (hold == NULL) {
+		ASSERT (curr->rwlock_overflow > 0);
+		curr->rwlock_overflow--;
+		return;
+	}
+	list_remove (&hold->elem);
+	if (!thread_mlfqs)
+		heap_remove (&curr->held_rwlocks, &hold->held_elem);
+	hold->rwlock = NULL;
+}
+
+/* Passes a change in the priority RW's waiters donate on to each
+   of its holders.  Interrupts must be off. */
+static void
+rwlock_donation_changed (struct rwlock *rw) {
+	struct list_elem *e;
+
+	for (e = list_begin (&rw->holders); e != list_end (&rw->holders);
+			e = list_next (e)) {
+		struct rwlock_hold *hold = list_entry (e, struct rwlock_hold, elem);
+
+		heap_update (&hold->thread->held_rwlocks, &hold->held_elem);
+		donation_update (hold->thread);
+	}
+}
+
+/* Donates the current thread's priority to every holder of RW
+   and sleeps on WAITERS until woken by rwlock_wake().  Interrupts
+   must be off. */
+static void
+rwlock_wait (struct rwlock *rw, struct heap *waiters) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	waiter_push (waiters, &curr->wait_elem);
+	if (!thread_mlfqs) {
+		curr->wait_on_rwlock = rw;
+		rwlock_donation_changed (rw);
+	}
+	thread_block ();
+}
+
+/* Removes the top thread from WAITERS, one of RW's wait heaps,
+   and wakes it up.  Interrupts must be off. */
+static void
+rwlock_wake_one (struct heap *waiters) {
+	struct thread *t = heap_entry (heap_pop (waiters), struct thread,
+			wait_elem);
+
+	if (t->wait_heap == waiters)
+		t->wait_heap = NULL;
+	t->wait_on_rwlock = NULL;
+	thread_unblock (t);
+}
+
+/* Wakes the waiters of RW that may be able to take it now: the
+   highest priority writer once there are no readers left, or
+   every reader if no writer is waiting.  Woken threads check
+   again, so waking one that loses the race is harmless. */
+static void
+rwlock_wake (struct rwlock *rw) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!heap_empty (&rw->write_waiters)) {
+		if (rw->readers > 0)
+			return;
+		rwlock_wake_one (&rw->write_waiters);
+	} else if (!heap_empty (&rw->read_waiters)) {
+		while (!heap_empty (&rw->read_waiters))
+			rwlock_wake_one (&rw->read_waiters);
+	} else
+		return;
+	if (!thread_mlfqs)
+		rwlock_donation_changed (rw);
+}
+
+/* Returns true if a new reader may take RW. */
+static bool
+rwlock_can_read (const struct rwlock *rw) {
+	return rw->writer == NULL && heap_empty (&rw->write_waiters);
+}
+
+/* Returns true if a writer may take RW. */
+static bool
+rwlock_can_write (const struct rwlock *rw) {
+	return rw->writer == NULL && rw->readers == 0;
+}
+
+/* Acquires RW for reading, sleeping while it is held for writing
+   or a writer is waiting for it.  RW must not already be held by
+   the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	while (!rwlock_can_read (rw))
+		rwlock_wait (rw, &rw->read_waiters);
+	rw->readers++;
+	rwlock_hold (rw);
+	intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping while anyone else holds it.
+   RW must not already be held by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	while (!rwlock_can_write (rw))
+		rwlock_wait (rw, &rw->write_waiters);
+	rw->writer = thread_current ();
+	rwlock_hold (rw);
+	intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for reading and returns true if successful
+   or false on failure.  RW must not already be held by the
+   current thread.
+
+   This function will not wait for RW, so it may be used on paths
+   that must not block on it, such as the page fault handler. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+	bool success;
+
+	ASSERT (rw != NULL);
+	ASSERT (!rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	success = rwlock_can_read (rw);
+	if (success) {
+		rw->readers++;
+		rwlock_hold (rw);
+	}
+	intr_set_level (old_level);
+	return success;
+}
+
+/* Tries to acquire RW for writing and returns true if successful
+   or false on failure.  RW must not already be held by the
+   current thread.
+
+   This function will not wait for RW, so it may be used on paths
+   that must not block on it, such as the page fault handler. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw) {
+	enum intr_level old_level;
+	bool success;
+
+	ASSERT (rw != NULL);
+	ASSERT (!rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	success = rwlock_can_write (rw);
+	if (success) {
+		rw->writer = thread_current ();
+		rwlock_hold (rw);
+	}
+	intr_set_level (old_level);
+	return success;
+}
+
+/* Drops the current thread's hold on RW, wakes whoever can take
+   it next and gives back the priority its waiters donated. */
+static void
+rwlock_release (struct rwlock *rw) {
+	enum intr_level old_level = intr_disable ();
+
+	rwlock_unhold (rw);
+	if (rw->writer != NULL) {
+		ASSERT (rw->writer == thread_current ());
+		rw->writer = NULL;
+	} else {
+		ASSERT (rw->readers > 0);
+		rw->readers--;
+	}
+	rwlock_wake (rw);
+	if (!thread_mlfqs)
+		donation_update (thread_current ());
+	intr_set_level (old_level);
+
+	if (preempt_by_priority ())
+		thread_yield ();
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer == NULL && rw->readers > 0);
+
+	rwlock_release (rw);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer == thread_current ());
+
+	rwlock_release (rw);
+}
+
+/* Returns true if the current thread holds RW for reading or
+   writing, false otherwise.  Read holds that did not fit in the
+   thread's RWLOCK_HOLD_MAX holds are not recorded, so they count
+   as not held. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	if (rw->writer != NULL)
+		return rw->writer == thread_current ();
+	return rwlock_hold_find (rw) != NULL;
+}
+
+/* Initializes spinlock LOCK as free.
+
+   Under -lockstat, acquisitions are counted under NAME unless it
+   is a null pointer.  Call this through the spinlock_init()
+   macro, which names LOCK after its source text. */
+void
+spinlock_init_named (struct spinlock *lock, const char *name) {
+	ASSERT (lock != NULL);
+
+	lock->locked = 0;
+	lock->old_level = INTR_OFF;
+	lock->stat = lockstat_enabled && name != NULL
+		? lockstat_register (name, true) : NULL;
+	lock->acquire_tsc = 0;
+}
+
+/* Disables interrupts and acquires LOCK, spinning until it is
+   free.  spinlock_release() restores the interrupt level.
+   Spinlocks are not recursive; acquiring one that this CPU
+   already holds never returns. */
+void
+spinlock_acquire (struct spinlock *lock) {
+	enum intr_level old_level;
+	bool contended = false;
+	uint64_t start = 0;
+
+	ASSERT (lock != NULL);
+
+	old_level = intr_disable ();
+	if (lock->stat != NULL)
+		start = rdtsc ();
+	while (__atomic_exchange_n (&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+		contended = true;
+		while (lock->locked)
+			asm volatile ("pause");
+	}
+	lock->old_level = old_level;
+	if (lock->stat != NULL) {
+		lock->acquire_tsc = rdtsc ();
+		lockstat_acquired (lock->stat, contended, lock->acquire_tsc - start,
+				__builtin_return_address (0));
+	}
+}
+
+/* Releases LOCK and restores the interrupt level it was acquired
+   at.  Nested spinlocks must be released in reverse order. */
+void
+spinlock_release (struct spinlock *lock) {
+	enum intr_level old_level;
+
+	ASSERT (spinlock_held (lock));
+
+	if (lock->stat != NULL)
+		lockstat_released (lock->stat, rdtsc () - lock->acquire_tsc);
+	old_level = lock->old_level;
+	__atomic_store_n (&lock->locked, 0, __ATOMIC_RELEASE);
+	intr_set_level (old_level);
+}
+
+/* Returns true if some CPU holds LOCK.  Only meaningful as an
+   assertion by the holder. */
+bool
+spinlock_held (const struct spinlock *lock) {
+	ASSERT (lock != NULL);
+
+	return lock->locked != 0;
+}
+
 /* ------------ project 1 ------------ */
-/* compare thread priority value in condition variable
-  1. make semaphore_elem by elem *a and *b
-  2. get semaphore's waiters by semaphore_elem
-  3. get thread priority of first thread of semaphore's waiters 
-  compare and return
- */
-static bool sema_priority_compare(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED){
-	struct semaphore_elem *sema_elem_a;
-	struct semaphore_elem *sema_elem_b;
-	struct list *a_waiter;
-	struct list *b_waiter;
-	int a_priority;
-	int b_priority;
-
-	sema_elem_a = list_entry(a, struct semaphore_elem, elem);
-	sema_elem_b = list_entry(b, struct semaphore_elem, elem);
-
-	a_waiter = &(sema_elem_a->semaphore.waiters);
-	b_waiter = &(sema_elem_b->semaphore.waiters);
-	
-	a_priority = list_entry(list_front(a_waiter), struct thread, elem)->priority;
-	b_priority = list_entry(list_front(b_waiter), struct thread, elem)->priority;
-
-	if (a_priority > b_priority){
-		return true;
-	}else{
-		return false;
-	}
-}
-
-/* if current thread want to acqurie lock and there is lock holder,
-	donate current thread priority to every single thread that lock holder is waiting for 
-	( depth limit = 8 according to test case ) */
-void donate_priority(void) {
-	int depth;
-	struct thread* curr = thread_current();
-	struct thread* holder = curr->wait_on_lock->holder;
-
-	for (depth = 0; depth < 8; depth++) {
-		if (!curr->wait_on_lock) break;
-		holder = curr->wait_on_lock->holder;
-		holder->priority = curr->priority;
-		curr = holder;
-	}
-}
-
-/* when current thread release THIS LOCK(argument struct lock *lock),
- the current thread remove only threads which want THIS LOCK in the current thread's donation_list.
- In which if current thread's donation list is not empty, it means current thread holds another lock. */
-void remove_donation_list_elem(struct lock *lock){
-	struct thread *curr = thread_current();
-
-	if (!list_empty(&curr->donation_list)) {
-		struct list_elem *e = list_begin(&curr->donation_list);
-		
-		for (e; e != list_end(&curr->donation_list); e = list_next(e)){
-			struct thread *t = list_entry(e, struct thread, donation_elem);
-			if (lock == t->wait_on_lock){
-				list_remove(&t->donation_elem);
-			}
+/* Ticket for FIFO order among waiters of equal priority. */
+static uint64_t wait_seq;
+
+/* Returns true if waiter A should be woken before B: the higher
+   priority first, and the earlier one among equals. */
+static bool
+waiter_more (const struct thread *a, const struct thread *b) {
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+	return a->wait_seq < b->wait_seq;
+}
+
+/* Orders threads in a semaphore's waiters heap. */
+static bool
+sema_waiter_more (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return waiter_more (heap_entry (a, struct thread, wait_elem),
+			heap_entry (b, struct thread, wait_elem));
+}
+
+/* Orders semaphore_elems in a condition variable's waiters heap
+   by the threads waiting on them. */
+static bool
+cond_waiter_more (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return waiter_more (heap_entry (a, struct semaphore_elem, elem)->thread,
+			heap_entry (b, struct semaphore_elem, elem)->thread);
+}
+
+/* Queues the current thread in WAITERS through ELEM.  Unless the
+   thread is already queued in a condition variable, whose private
+   semaphore never has another waiter, it remembers where, so that
+   thread_update_priority() can reposition it in O(log n) when a
+   donation changes its priority.  Interrupts must be off. */
+static void
+waiter_push (struct heap *waiters, struct heap_elem *elem) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (curr->wait_heap == NULL) {
+		curr->wait_heap = waiters;
+		curr->wait_link = elem;
+		curr->wait_seq = wait_seq++;
+	}
+	heap_push (waiters, elem);
+}
+
+/* Orders threads in a lock's donors heap by descending priority. */
+static bool
+lock_donor_more (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, donor_elem)->priority
+		> heap_entry (b, struct thread, donor_elem)->priority;
+}
+
+/* Returns the priority LOCK's waiters donate to its holder, or
+   PRI_MIN - 1 if nobody is waiting. */
+static int
+lock_donation (const struct lock *lock) {
+	if (heap_empty (&lock->donors))
+		return PRI_MIN - 1;
+	return heap_entry (heap_min (&lock->donors), struct thread,
+			donor_elem)->priority;
+}
+
+/* Orders the locks in a thread's held_locks heap by descending
+   donation, so the top one carries the thread's donated priority. */
+bool
+lock_donation_more (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return lock_donation (heap_entry (a, struct lock, held_elem))
+		> lock_donation (heap_entry (b, struct lock, held_elem));
+}
+
+/* Returns the priority RW's waiters donate to each of its
+   holders, or PRI_MIN - 1 if nobody is waiting. */
+static int
+rwlock_donation (const struct rwlock *rw) {
+	int priority = PRI_MIN - 1;
+	const struct heap *waiters[2] = { &rw->read_waiters, &rw->write_waiters };
+
+	for (int i = 0; i < 2; i++)
+		if (!heap_empty (waiters[i])) {
+			int p = heap_entry (heap_min (waiters[i]), struct thread,
+					wait_elem)->priority;
+			if (priority < p)
+				priority = p;
 		}
+	return priority;
+}
+
+/* Orders the holds in a thread's held_rwlocks heap by descending
+   donation, like lock_donation_more(). */
+bool
+rwlock_donation_more (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return rwlock_donation (heap_entry (a, struct rwlock_hold, held_elem)->rwlock)
+		> rwlock_donation (heap_entry (b, struct rwlock_hold, held_elem)->rwlock);
+}
+
+/* Returns T's own priority raised to the highest priority donated
+   to it through the locks and rwlocks it holds. */
+static int
+effective_priority (struct thread *t) {
+	int priority = t->initial_priority;
+
+	if (!heap_empty (&t->held_locks)) {
+		int donated = lock_donation (heap_entry (heap_min (&t->held_locks),
+					struct lock, held_elem));
+		if (priority < donated)
+			priority = donated;
+	}
+
+	/* threads waiting on an rwlock donate to all of its holders */
+	if (!heap_empty (&t->held_rwlocks)) {
+		int donated = rwlock_donation (heap_entry (heap_min (&t->held_rwlocks),
+					struct rwlock_hold, held_elem)->rwlock);
+		if (priority < donated)
+			priority = donated;
+	}
+	return priority;
+}
+
+/* Recomputes T's priority from its cached donations and, if it
+   changed, repositions T among the donors of the lock it waits
+   for and passes the change on to that lock's holder, and so on
+   down the chain.  Each step costs O(log n) and the walk stops at
+   the first thread whose priority stays the same, so there is no
+   depth limit and nothing is rescanned.  A thread waiting on an
+   rwlock passes the change on to every holder of the rwlock
+   instead.  Interrupts must be off. */
+static void
+donation_update (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (;;) {
+		int priority = effective_priority (t);
+		struct lock *lock = t->wait_on_lock;
+
+		if (priority == t->priority)
+			break;
+		/* Also repositions T in its rwlock's waiters heap. */
+		thread_update_priority (t, priority);
+		if (t->wait_on_rwlock != NULL) {
+			rwlock_donation_changed (t->wait_on_rwlock);
+			break;
+		}
+		if (lock == NULL)
+			break;
+		heap_update (&lock->donors, &t->donor_elem);
+		if (lock->holder == NULL)
+			break;
+		t = lock->holder;
+		heap_update (&t->held_locks, &lock->held_elem);
 	}
 }
 
@@ -462,18 +1199,9 @@ void remove_donation_list_elem(struct lock *lock){
 	if there is donated thread to currnet thread, find the bigger priority and set to current thread priority.
 	if not, set current priority to initial priority.*/
 void reset_priority(void){
-	struct thread *curr = thread_current();
-	curr->priority = curr->initial_priority;
+	enum intr_level old_level = intr_disable ();
 
-	if (!list_empty(&curr->donation_list)){
-		list_sort(&curr->donation_list, &thread_donate_priority_compare, NULL);
-		
-		struct list_elem *donated_e = list_front(&curr->donation_list);
-
-		int max_donated_priority = list_entry(donated_e, struct thread, donation_elem)->priority;
-		if (curr->priority<max_donated_priority){
-			curr->priority = max_donated_priority;
-		}
-	}
+	donation_update (thread_current ());
+	intr_set_level (old_level);
 }
-/* ------------------- project 1 functions end ------------------------------- */
\ No newline at end of file
+/* ------------------- project 1 functions end ------------------------------- */
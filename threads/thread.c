@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -7,10 +8,16 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
+#include <heap.h>
+#include <hist.h>
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -24,17 +31,87 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Ready threads of one priority-ordered scheduling class.
+   There is one FIFO list per priority level, and bit P of `mask'
+   is set if and only if queues[P] is non-empty, so the highest
+   priority ready thread is found with a single bit scan. */
+#if PRI_MAX - PRI_MIN >= 64
+#error run queue mask needs one bit per priority level
+#endif
+struct prio_array {
+	struct list queues[PRI_MAX - PRI_MIN + 1];
+	uint64_t mask;              /* Bit P set if queues[P] non-empty. */
+};
+
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   Each scheduling class keeps its own ready threads, and the
+   highest class with one runs it (see struct sched_class).  Only
+   the boot CPU runs threads, so there is a single run queue; its
+   spinlock, like any spinlock on one CPU, amounts to turning
+   interrupts off. */
+struct runqueue {
+	struct spinlock lock;       /* Protects the members below. */
+	struct prio_array rt;       /* SCHED_FIFO and SCHED_RR threads. */
+	struct prio_array prio;     /* SCHED_PRIO threads. */
+	struct heap fair;           /* SCHED_FAIR threads, least vruntime first. */
+	uint64_t min_vruntime;      /* Monotonic floor of fair vruntimes. */
+	int cnt;                    /* # of threads in all classes. */
+	struct thread *curr;        /* Running thread. */
+	struct thread *idle;        /* Idle thread. */
+	struct hist wait_hist;      /* -schedlat: ready to running. */
+	struct hist wakeup_hist;    /* -schedlat: sleep deadline to running. */
+};
+static struct runqueue runqueue;
+
+/* A scheduling class.  Classes are ranked, and a ready thread of
+   a higher class always runs before one of a lower class, so a
+   real-time thread waits at most for the running thread to reach
+   its next preemption point.  All hooks are called with the run
+   queue locked. */
+struct sched_class {
+	void (*enqueue) (struct runqueue *, struct thread *);
+	void (*dequeue) (struct runqueue *, struct thread *);
+
+	/* Returns the thread of this class to run next, leaving it
+	   queued, or a null pointer if the class has none ready. */
+	struct thread *(*pick) (struct runqueue *);
+
+	/* Returns true if a ready thread of this class should
+	   preempt CURR, which belongs to it too. */
+	bool (*preempt) (struct runqueue *, struct thread *curr);
+
+	/* Charges CURR one timer tick.  Returns true if its time
+	   slice is used up. */
+	bool (*tick) (struct runqueue *, struct thread *curr);
+};
+
+/* SCHED_FAIR: CPU time is shared in proportion to each thread's
+   weight, which falls by about 1.25x per nice level, as in
+   Linux's CFS.  Each thread's `vruntime' advances by the time it
+   runs scaled by FAIR_WEIGHT_NICE0 / weight, and the thread with
+   the least vruntime runs next.  A thread that wakes up or joins
+   the class starts no further behind than FAIR_SLEEPER_BONUS,
+   so sleeping cannot bank an unbounded claim on the CPU. */
+#define FAIR_WEIGHT_NICE0 1024
+#define FAIR_GRANULARITY NS_PER_TICK        /* Min vruntime lead to preempt. */
+#define FAIR_SLEEPER_BONUS (TIME_SLICE * NS_PER_TICK / 2)
+static const int fair_weights[NICE_MAX - NICE_MIN + 1] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */  9548,  7620,  6100,  4904,  3906,
+	/*  -5 */  3121,  2501,  1991,  1586,  1277,
+	/*   0 */  1024,   820,   655,   526,   423,
+	/*   5 */   335,   272,   215,   172,   137,
+	/*  10 */   110,    87,    70,    56,    45,
+	/*  15 */    36,    29,    23,    18,    15,
+	/*  20 */    12,
+};
 
 /* ----- project 1 ------------ */
-static struct list sleep_list; /* sleep list for blocked threads */
+static struct heap sleep_heap; /* sleeping threads, earliest wake_up_tick first */
 /* --------------------------- */
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
@@ -44,6 +121,28 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
+/* Caches of free pages for reuse, each a singly linked list
+   threaded through the first word of every cached block.  Exited
+   threads' pages and user processes' fd tables go here, up to
+   `max', instead of back to palloc, so fork-heavy workloads skip
+   the page allocator and the zeroing of a fresh block.  palloc
+   empties them through thread_shrink_caches() before it gives up
+   on a kernel allocation. */
+struct free_cache {
+	struct spinlock lock;       /* Protects the members below. */
+	void *head;                 /* First cached block, or null. */
+	int cnt;                    /* # of cached blocks. */
+	int max;                    /* Max # of cached blocks. */
+};
+#define THREAD_CACHE_MAX 16     /* Max # of cached thread pages. */
+#define FDT_CACHE_MAX 8         /* Max # of cached fd tables. */
+static struct free_cache thread_cache;
+static struct free_cache fdt_cache;
+
+/* List of all threads that have not exited, for statistics. */
+static struct list all_list;
+static struct lock all_lock;
+
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
@@ -57,11 +156,36 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 static int64_t next_tick_to_awake; /* the earliest awake time in sleep list */
 /* --------------------------------- */
 
+/* Multi-level feedback queue scheduler (-o mlfqs).
+
+   Only the running thread is charged each tick.  The once-per-
+   second recent_cpu decay is applied eagerly to the running and
+   ready threads, since their run queue depends on it, but a
+   blocked thread is only brought up to date when it is unblocked:
+   each thread remembers the last second (`cpu_epoch') it was
+   decayed for, and mlfqs_decay keeps the coefficients of the last
+   MLFQS_DECAY_HISTORY seconds so the missed ones can be replayed. */
+#define MLFQS_DECAY_HISTORY 64  /* # of per-second coefficients kept. */
+static fixed_t load_avg;        /* System load average. */
+static int64_t sched_ticks;     /* # of timer ticks since boot. */
+static int64_t mlfqs_epoch;     /* # of seconds since boot. */
+static fixed_t mlfqs_decay[MLFQS_DECAY_HISTORY]; /* By epoch modulo size. */
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* -schedlat: trace scheduler latency? */
+bool thread_schedlat;
+
+/* A thread's scheduler latency histograms, allocated only when
+   -schedlat is given so that struct thread stays small. */
+struct thread_latency {
+	struct hist wait;           /* Cycles from ready to running. */
+	struct hist wakeup;         /* Cycles from sleep deadline to running. */
+};
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -70,6 +194,27 @@ static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static struct thread *ready_queue_pick (struct runqueue *);
+static const struct sched_class *sched_class_of (const struct thread *);
+static void prio_array_init (struct prio_array *);
+static bool fair_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static void free_cache_init (struct free_cache *, int max, const char *name);
+static void *free_cache_get (struct free_cache *);
+static bool free_cache_put (struct free_cache *, void *);
+static size_t free_cache_shrink (struct free_cache *, size_t page_cnt);
+static void schedlat_switch (struct runqueue *, struct thread *curr,
+		struct thread *next);
+static bool thread_wake_up_tick_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+static void mlfqs_tick (struct thread *);
+static void schedlat_print (struct thread *);
+static void mlfqs_second (void);
+static void mlfqs_refresh (struct thread *);
+static int mlfqs_priority (const struct thread *);
+static void wait_queue_update (struct thread *);
 
 
 /* ------------------- project 1 -------------------- */
@@ -78,7 +223,6 @@ void thread_awake(int64_t ticks);
 int64_t get_next_tick_to_awake(void);
 bool thread_priority_compare (struct list_elem *element1, struct list_elem *element2, void *aux UNUSED); 
 bool preempt_by_priority(void);
-bool thread_donate_priority_compare (struct list_elem *element1, struct list_elem *element2, void *aux UNUSED);
 /* -------------------------------------------------- */
 /* ------------------- project 2 -------------------- */
 struct thread* get_child_by_tid(tid_t tid);
@@ -94,6 +238,9 @@ struct thread* get_child_by_tid(tid_t tid);
  * somewhere in the middle, this locates the curent thread. */
 #define running_thread() ((struct thread *) (pg_round_down (rrsp ())))
 
+/* Returns true if T is the idle thread. */
+#define is_idle(t) ((t) == runqueue.idle)
+
 
 // Global descriptor table for the thread_start.
 // Because the gdt will be setup after the thread_init, we should
@@ -141,12 +288,22 @@ thread_current는 lock_acquire()와 같은 함수에서 많이 호출되므로 
 
 	/* Init the global thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&sleep_list);		/* sleep_list를 초기화 (추가) */
+	spinlock_init_named (&runqueue.lock, "run queue");
+	prio_array_init (&runqueue.rt);
+	prio_array_init (&runqueue.prio);
+	heap_init (&runqueue.fair, fair_less, NULL);
+	runqueue.min_vruntime = 0;
+	runqueue.cnt = 0;
+	hist_init (&runqueue.wait_hist);
+	hist_init (&runqueue.wakeup_hist);
 	list_init (&destruction_req);
+	list_init (&all_list);
+	lock_init (&all_lock);
+	free_cache_init (&thread_cache, THREAD_CACHE_MAX, "thread cache");
+	free_cache_init (&fdt_cache, FDT_CACHE_MAX, "fdt cache");
 
 	/* ------------- project 1 ---------------- */
-	list_init (&sleep_list); /* sleep list init for blocked thread */
+	heap_init (&sleep_heap, thread_wake_up_tick_less, NULL); /* sleep heap init for blocked thread */
 	next_tick_to_awake = INT64_MAX; /* next_tick_to_awake 초기화 */
 	/* ---------------------------------------- */
 
@@ -155,6 +312,8 @@ thread_current는 lock_acquire()와 같은 함수에서 많이 호출되므로 
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
+	runqueue.curr = initial_thread;
+	list_push_back (&all_list, &initial_thread->all_elem);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -166,10 +325,13 @@ thread_start (void) {
 	sema_init (&idle_started, 0);
 	thread_create ("idle", PRI_MIN, idle, &idle_started);
 
+	if (thread_schedlat)
+		initial_thread->latency = calloc (1, sizeof *initial_thread->latency);
+
 	/* Start preemptive thread scheduling. */
 	intr_enable (); // 인터럽트 활성화
 
-	/* Wait for the idle thread to initialize idle_thread. */
+	/* Wait for the idle thread to register itself. */
 	sema_down (&idle_started);
 }
 
@@ -178,9 +340,11 @@ thread_start (void) {
 void
 thread_tick (void) {
 	struct thread *t = thread_current ();
+	struct runqueue *rq;
+	bool expired;
 
 	/* Update statistics. */
-	if (t == idle_thread)
+	if (is_idle (t))
 		idle_ticks++;
 #ifdef USERPROG
 	else if (t->pml4 != NULL)
@@ -189,80 +353,63 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
+	sched_ticks++;
+	if (thread_mlfqs)
+		mlfqs_tick (t);
+
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	rq = &runqueue;
+	spinlock_acquire (&rq->lock);
+	expired = sched_class_of (t)->tick (rq, t);
+	spinlock_release (&rq->lock);
+	if (expired)
 		intr_yield_on_return ();
 }
 
-/* Alarm Clock 추가. 실행 중인 스레드를 슬립으로 만듦, 인자로 들어온 ticks까지 재움 */
-// Thread를 blocked 상태로 만들고 sleep queue에 삽입하여 대기, timer_sleep()함수에 의해 호출됨. 
-void thread_sleep(int64_t ticks) {
-	struct thread* curr;
-
-	enum intr_level old_level;
-	old_level = intr_disable(); // 이 라인 이후의 과정 중에는 인터럽트를 받아들이지 않는다
-	// 다만 나중에 다시 받아들이기 위해 old_level에 이전 인터럽트 상태를 담아둔다
-
-	curr = thread_current(); // 현재의 thread 주소를 가져온다
-	ASSERT(curr != idle_thread); // 현재의 thread가 idle thread이면 sleep 되지 않아야 함.
-
-	// awake함수가 실행되어야 할 tick값을 update
-	update_next_tick_to_awake(curr->wakeup_tick = ticks); // 현재의 thread의 wakeup_ticks에 인자로 들어온 ticks를 저장후 next_tick_to_awake를 업데이트한다
-	list_push_back(&sleep_list, &(curr->elem)); // sleep_list에 현재 thread의 element를 슬립 리스트(슬립 큐)의 마지막에 삽입한 후에 스케쥴한다.
-
-	thread_block(); // 현재 thread를 block 시킴. 다시 스케쥴 될 때 까지 블락된 상태로 대기
-
-	/* 현재 스레드를 슬립 큐에 삽입한 후에 스케쥴 한다. 해당 과정 중에는 인터럽트를 받아들이지 않는다. */
-
-	intr_set_level(old_level); // 다시 스케쥴하러 갈 수 있게 만들어줌 (인터럽트를 다시 받아들여서 인터럽트가 가능하도록 수정함)
-	/* 여기서 현재 스레드가 idle thread 이면 sleep 되지 않도록 해야한다. idle 스레드는 운영체제가 초기화되고 ready_list가 생성될때 첫번째로 추가되는 스레드이다. 
-		굳이 이 스레드를 만들어준 이유는 CPU를 실행상태로 유지하기 위함이다.
-		CPU가 할일이 없으면 아예 꺼져버리고, 할 일이 생기면 다시 켜지는 방식이므로 소모되는 전력보다 무의미한 일이라도 그냥 계속 하고 있는게 더 적은 전력을 소모한다. */
-}
-
-/* 이제 재우고 sleep_list에 넣어뒀으니 sleep_list에서 꺼내서 깨울 함수가 필요. 이 함수가 thread_awake 함수. 
-	sleep list의 모든 entry를 순회하면서 현재 tick이 깨워야 할 tick 보다 크다면 슬립 큐에서 제거하고 unblock해준다(깨운다). 
-	작다면 next_tick_to_awake변수를 갱신하기 위해 update_next_tick_to_awake()를 호출한다. */
-/* Alarm Clock 추가. wakeup_tick값이 ticks보다 작거나 같은 스레드를 깨움, 
-	현재 대기중인 스레드들의 wakeup_tick변수 중 가장 작은 값을 next_tick_to_awake 전역 변수에 저장 */
-void thread_awake(int64_t ticks) {
-	// next_tick_to_awake = INT64_MAX;
-	// struct list_elem* curr_elem = list_begin(&sleep_list);
-	// struct thread* curr_thread;
-	// //printf("thread_awake is called \n");
-
-	// /* sleep list의 모든 entry를 순회하며 다음과 같은 작업을 수행한다.
-	// 	현재 tick이 깨워야 할 tick보다 크거나 같다면 슬립큐에서 제거하고 unblock한다.
-	// 	작다면 update_next_tick_to_awake()를 호출한다. */
-	// while (curr_elem != list_end(&sleep_list)) {
-	// 	curr_thread = list_entry(curr_elem, struct thread, elem);
-
-	// 	if (curr_thread->wakeup_tick <= ticks){ // 현재시간(ticks)가 더 크면 리무브(슬립리스트에서 뻄)-언블락(깨움)
-	// 		curr_elem = list_remove(curr_elem);
-	// 		thread_unblock(curr_thread);
-	// 	}
-	// 	else {
-	// 		curr_elem = list_next(curr_elem);
-	// 		update_next_tick_to_awake(curr_thread->wakeup_tick);
-		// }
-	// }
-	struct list_elem *e = list_begin(&sleep_list);
-	while (e != list_end (&sleep_list)) {
-		struct thread *t = list_entry(e, struct thread, elem);
-		if (t -> wakeup_tick <= ticks) {
-			e = list_remove(e);
-			thread_unblock(t);
-		}
-		else 
-			e = list_next(e);
-	}
-}
-
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+
+	if (thread_schedlat) {
+		struct hist wait, wakeup;
+		struct list_elem *e;
+
+		hist_init (&wait);
+		hist_init (&wakeup);
+		hist_merge (&wait, &runqueue.wait_hist);
+		hist_merge (&wakeup, &runqueue.wakeup_hist);
+		printf ("Scheduler latency, in TSC cycles (%"PRIu64" per tick):\n",
+				timer_tsc_per_tick ());
+		hist_print (&wait, "Run queue wait");
+		hist_print (&wakeup, "Sleep wakeup to run");
+
+		/* Threads that already exited printed theirs on the way
+		   out.  Skip the live ones if we got here by panicking. */
+		if (!intr_context () && !lock_held_by_current_thread (&all_lock)
+				&& lock_try_acquire (&all_lock)) {
+			for (e = list_begin (&all_list); e != list_end (&all_list);
+					e = list_next (e))
+				schedlat_print (list_entry (e, struct thread, all_elem));
+			lock_release (&all_lock);
+		}
+	}
+}
+
+/* Prints T's scheduler latency histograms, if it has any. */
+static void
+schedlat_print (struct thread *t) {
+	char title[48];
+
+	if (t->latency == NULL || t->latency->wait.count == 0)
+		return;
+	snprintf (title, sizeof title, "Thread %s run queue wait", t->name);
+	hist_print (&t->latency->wait, title);
+	if (t->latency->wakeup.count != 0) {
+		snprintf (title, sizeof title, "Thread %s sleep wakeup to run", t->name);
+		hist_print (&t->latency->wakeup, title);
+	}
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -283,15 +430,6 @@ thread_print_stats (void) {
 
 
 
-/* Sets the current thread's priority to NEW_PRIORITY. 현재 스레드의 우선순위를 새 우선순위로 정한다. */ 
-void
-thread_set_priority (int new_priority) {
-  thread_current ()->init_priority = new_priority;
-  refresh_priority (); /* Donate 추가 */ // 우선순위 내림차순 정렬
-  thread_test_preemption (); /* Priority Scheduling 추가 */
-  
-}
-
 tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
@@ -301,26 +439,52 @@ thread_create (const char *name, int priority,
 
 	ASSERT (function != NULL);
 
-	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO); /* 페이지 할당 */
+	/* Allocate thread.  init_thread() clears struct thread, and the
+	   rest of the page is stack, so a recycled page needs no zeroing. */
+	t = free_cache_get (&thread_cache);
+	if (t == NULL)
+		t = palloc_get_page (0); /* 페이지 할당 */
 	if (t == NULL)
 		return TID_ERROR;
 
 	/* Initialize thread. */
 	init_thread (t, name, priority);
+
+	/* A new thread inherits its parent's scheduling class and
+	   starts level with the fair threads already ready.  The
+	   idle thread stays in SCHED_PRIO. */
+	if (function != idle) {
+		t->policy = thread_current ()->policy;
+		t->vruntime = runqueue.min_vruntime;
+	}
+
+	/* A new thread inherits its parent's nice and recent_cpu, and
+	   under the MLFQS its priority follows from them.  The idle
+	   thread keeps PRI_MIN. */
+	if (thread_mlfqs && function != idle) {
+		struct thread *curr = thread_current ();
+
+		t->nice = curr->nice;
+		t->recent_cpu = curr->recent_cpu;
+		t->cpu_epoch = curr->cpu_epoch;
+		if (t->policy == SCHED_PRIO)
+			t->priority = t->initial_priority = mlfqs_priority (t);
+	}
 	struct  thread *parent = thread_current();
 	list_push_back(&parent->child_list, &t->child_elem);
-	
-	t->fd_table = palloc_get_multiple(PAL_ZERO, FDT_PAGES);
-	if (t->fd_table == NULL)
-		return TID_ERROR;
+
+	lock_acquire (&all_lock);
+	list_push_back (&all_list, &t->all_elem);
+	lock_release (&all_lock);
+	if (thread_schedlat && function != idle)
+		t->latency = calloc (1, sizeof *t->latency);
+
 	tid = t->tid = 
 	allocate_tid ();
 	
+	/* the fd table is allocated by the first open(), see thread_fdt_alloc() */
+	t->fd_table = NULL;
 	t->fd_idx = 2;
-	t->fd_table[0] = 1; /* dummy value for STDIN */
-	t->fd_table[1] = 2; /* dummy value for STDOUT */
-	// t->fd_table[2] = 0; /* dummy value for STDERR (current Pintos version doesn't consider STDERR) */
 
 
 	/* Call the kernel_thread if it scheduled.
@@ -380,8 +544,15 @@ thread_unblock (struct thread *t) {
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
 	
-	list_push_back (&ready_list, &t->elem);
+	if (thread_mlfqs)
+		mlfqs_refresh (t);
+	if (thread_schedlat)
+		t->ready_tsc = rdtsc ();
+	struct runqueue *rq = &runqueue;
+	spinlock_acquire (&rq->lock);
+	ready_queue_push (t);
 	t->status = THREAD_READY;
+	spinlock_release (&rq->lock);
 	
 	intr_set_level (old_level);
 }
@@ -426,6 +597,15 @@ thread_exit (void) {
 	process_exit ();
 #endif
 
+	lock_acquire (&all_lock);
+	list_remove (&thread_current ()->all_elem);
+	lock_release (&all_lock);
+	if (thread_current ()->latency != NULL) {
+		schedlat_print (thread_current ());
+		free (thread_current ()->latency);
+		thread_current ()->latency = NULL;
+	}
+
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
@@ -444,8 +624,14 @@ thread_yield (void) {
 
 	old_level = intr_disable ();
 
-	if (curr != idle_thread)
-		list_push_back(&ready_list, &curr->elem);
+	if (!is_idle (curr)) {
+		struct runqueue *rq = &runqueue;
+
+		spinlock_acquire (&rq->lock);
+
+		ready_queue_push (curr);
+		spinlock_release (&rq->lock);
+	}
 	
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
@@ -454,6 +640,10 @@ thread_yield (void) {
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) {
+	/* The MLFQS computes priorities itself. */
+	if (thread_mlfqs && thread_current ()->policy == SCHED_PRIO)
+		return;
+
 	thread_current ()->initial_priority = new_priority;
 
 	/* --------- project1 ---------- */
@@ -464,6 +654,42 @@ thread_set_priority (int new_priority) {
 	/* ----------------------------- */
 }
 
+/* Moves the current thread to scheduling class POLICY.  PRIORITY
+   is its priority under SCHED_FIFO and SCHED_RR and is ignored
+   otherwise.  A thread entering SCHED_FAIR starts level with the
+   fair threads.  Returns false, changing nothing, if
+   POLICY or PRIORITY is invalid. */
+bool
+thread_set_policy (enum sched_policy policy, int priority) {
+	struct thread *curr = thread_current ();
+	bool rt = policy == SCHED_FIFO || policy == SCHED_RR;
+	enum intr_level old_level;
+
+	if ((int) policy < SCHED_FIFO || (int) policy > SCHED_FAIR)
+		return false;
+	if (rt && (priority < PRI_MIN || priority > PRI_MAX))
+		return false;
+
+	/* The running thread is in no run queue, so its class can
+	   change without requeueing it. */
+	old_level = intr_disable ();
+	if (policy == SCHED_FAIR && curr->policy != SCHED_FAIR)
+		curr->vruntime = runqueue.min_vruntime;
+	curr->policy = policy;
+	if (thread_mlfqs && policy == SCHED_PRIO)
+		mlfqs_refresh (curr);
+	thread_ticks = 0;
+	intr_set_level (old_level);
+
+	if (rt) {
+		curr->initial_priority = priority;
+		reset_priority ();
+	}
+	if (preempt_by_priority ())
+		thread_yield ();
+	return true;
+}
+
 /* Returns the current thread's priority. 현재 스레드의 우선순위를 반환한다. */
 int
 thread_get_priority (void) {
@@ -475,51 +701,61 @@ bool thread_compare_priority (struct list_elem *l, struct list_elem *s, void *au
     return list_entry (l, struct thread, elem)->priority > list_entry (s, struct thread, elem)->priority;
 }
 
-/* Donate 추가 */
-bool
-thread_compare_donate_priority (const struct list_elem *l, 
-				const struct list_elem *s, void *aux UNUSED)
-{
-	return list_entry (l, struct thread, donation_elem)->priority
-		 > list_entry (s, struct thread, donation_elem)->priority;
-}
-
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recalculates
+   its priority, yielding if it no longer has the highest. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+	old_level = intr_disable ();
+	curr->nice = nice;
+	if (thread_mlfqs && curr->policy == SCHED_PRIO && !is_idle (curr)) {
+		curr->priority = curr->initial_priority = mlfqs_priority (curr);
+		wait_queue_update (curr);
+	}
+	intr_set_level (old_level);
+
+	if (preempt_by_priority ())
+		thread_yield ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load = fp_to_int_round (fp_mul_int (load_avg, 100));
+	intr_set_level (old_level);
+	return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int cpu = fp_to_int_round (fp_mul_int (thread_current ()->recent_cpu, 100));
+	intr_set_level (old_level);
+	return cpu;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it registers itself as the idle thread, "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  After that, the idle thread never
+   appears in the ready list.  It is returned by
+   next_thread_to_run() as a special case when the ready list is
+   empty. */
 static void
 idle (void *idle_started_ UNUSED) {
 /* thread_start() 에서 thread_create 을 하는 순간 idle thread 가 생성되고 동시에 idle 함수가 실행된다. 
@@ -529,7 +765,7 @@ idle (void *idle_started_ UNUSED) {
 	이는 CPU 가 무조건 하나의 thread 는 실행하고 있는 상태를 만들기 위함이다. */
 	struct semaphore *idle_started = idle_started_;
 
-	idle_thread = thread_current ();
+	runqueue.idle = thread_current ();
 	sema_up (idle_started);
 
 	for (;;) {
@@ -537,6 +773,12 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* In tickless mode, don't take a timer interrupt every
+		   tick while there is nothing to run; sleep until the
+		   next sleeping thread or delayed work is due instead. */
+		timer_idle_enter (next_tick_to_awake < workqueue_next_tick ()
+				? next_tick_to_awake : workqueue_next_tick ());
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -584,12 +826,15 @@ init_thread (struct thread *t, const char *name, int priority) {
 	strlcpy (t->name, name, sizeof t->name);
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	t->priority = priority; // 이 줄이 없어서 FAIL떴음
+	t->policy = SCHED_PRIO;
 	t->magic = THREAD_MAGIC;
 
 	/* -------- Project 1 ----------- */
-	list_init (&t->donation_list);
+	heap_init (&t->held_locks, lock_donation_more, NULL);
+	heap_init (&t->held_rwlocks, rwlock_donation_more, NULL);
 	t->initial_priority = priority;
 	t->wait_on_lock = NULL;
+	t->wait_on_rwlock = NULL;
 	/* ------------------------------ */
 	
 	/* -------- Project 2 ----------- */
@@ -604,19 +849,424 @@ init_thread (struct thread *t, const char *name, int priority) {
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is 
+   return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return idle_thread. */
+   will be in the run queue.)  If the run queue is empty, return
+   the idle thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else{
-		/* ---------------- project 1 -----------------*/
-		list_sort(&ready_list, &thread_priority_compare, NULL);
-		/* --------------------------------------------*/
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct runqueue *rq = &runqueue;
+	struct thread *next;
+
+	spinlock_acquire (&rq->lock);
+	if ((next = ready_queue_pick (rq)) != NULL)
+		ready_queue_remove (next);
+	else
+		next = rq->idle;
+	rq->curr = next;
+	spinlock_release (&rq->lock);
+	return next;
+}
+
+/* Adds T to its class's ready threads.
+   The run queue must be locked. */
+static void
+ready_queue_push (struct thread *t) {
+	struct runqueue *rq = &runqueue;
+
+	ASSERT (spinlock_held (&rq->lock));
+	sched_class_of (t)->enqueue (rq, t);
+	rq->cnt++;
+}
+
+/* Removes T from its class's ready threads.
+   The run queue must be locked. */
+static void
+ready_queue_remove (struct thread *t) {
+	struct runqueue *rq = &runqueue;
+
+	ASSERT (spinlock_held (&rq->lock));
+	sched_class_of (t)->dequeue (rq, t);
+	rq->cnt--;
+}
+
+static void
+prio_array_init (struct prio_array *a) {
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init (&a->queues[pri - PRI_MIN]);
+	a->mask = 0;
+}
+
+/* Appends T to the tail of the queue for its priority in A. */
+static void
+prio_array_push (struct prio_array *a, struct thread *t) {
+	int idx = t->priority - PRI_MIN;
+
+	list_push_back (&a->queues[idx], &t->elem);
+	a->mask |= 1ULL << idx;
+}
+
+/* Removes T from the queue for its priority in A. */
+static void
+prio_array_remove (struct prio_array *a, struct thread *t) {
+	int idx = t->priority - PRI_MIN;
+
+	list_remove (&t->elem);
+	if (list_empty (&a->queues[idx]))
+		a->mask &= ~(1ULL << idx);
+}
+
+/* Returns the first thread of the highest non-empty priority in
+   A, or a null pointer if A is empty. */
+static struct thread *
+prio_array_front (struct prio_array *a) {
+	if (a->mask == 0)
+		return NULL;
+	return list_entry (list_front (&a->queues[63 - __builtin_clzll (a->mask)]),
+			struct thread, elem);
+}
+
+/* Returns true if A holds a thread of higher priority than T. */
+static bool
+prio_array_preempts (const struct prio_array *a, const struct thread *t) {
+	return a->mask != 0
+		&& t->priority < PRI_MIN + 63 - __builtin_clzll (a->mask);
+}
+
+/* SCHED_FIFO and SCHED_RR.  A preempted FIFO thread goes to the
+   tail of its priority's queue, like one that yields. */
+static void
+rt_enqueue (struct runqueue *rq, struct thread *t) {
+	prio_array_push (&rq->rt, t);
+}
+
+static void
+rt_dequeue (struct runqueue *rq, struct thread *t) {
+	prio_array_remove (&rq->rt, t);
+}
+
+static struct thread *
+rt_pick (struct runqueue *rq) {
+	return prio_array_front (&rq->rt);
+}
+
+static bool
+rt_preempt (struct runqueue *rq, struct thread *curr) {
+	return prio_array_preempts (&rq->rt, curr);
+}
+
+static bool
+rt_tick (struct runqueue *rq UNUSED, struct thread *curr) {
+	return curr->policy == SCHED_RR && ++thread_ticks >= TIME_SLICE;
+}
+
+/* SCHED_PRIO: round robin among the highest priority, with the
+   priorities set by thread_set_priority() or the MLFQS. */
+static void
+prio_enqueue (struct runqueue *rq, struct thread *t) {
+	prio_array_push (&rq->prio, t);
+}
+
+static void
+prio_dequeue (struct runqueue *rq, struct thread *t) {
+	prio_array_remove (&rq->prio, t);
+}
+
+static struct thread *
+prio_pick (struct runqueue *rq) {
+	return prio_array_front (&rq->prio);
+}
+
+static bool
+prio_preempt (struct runqueue *rq, struct thread *curr) {
+	return prio_array_preempts (&rq->prio, curr);
+}
+
+static bool
+prio_tick (struct runqueue *rq UNUSED, struct thread *curr UNUSED) {
+	return ++thread_ticks >= TIME_SLICE;
+}
+
+/* SCHED_FAIR. */
+
+/* Orders fair threads by vruntime, then by tid so that equal
+   vruntimes do not depend on the heap's shape. */
+static bool
+fair_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = heap_entry (a_, struct thread, fair_elem);
+	const struct thread *b = heap_entry (b_, struct thread, fair_elem);
+
+	if (a->vruntime != b->vruntime)
+		return a->vruntime < b->vruntime;
+	return a->tid < b->tid;
+}
+
+/* Returns T's share of the CPU relative to a nice 0 thread's
+   FAIR_WEIGHT_NICE0. */
+static int
+fair_weight (const struct thread *t) {
+	return fair_weights[t->nice - NICE_MIN];
+}
+
+/* Advances RQ's min_vruntime to the least vruntime among its
+   running and ready fair threads, never moving it back. */
+static void
+fair_update_min (struct runqueue *rq) {
+	uint64_t min = UINT64_MAX;
+
+	if (rq->curr != NULL && rq->curr->policy == SCHED_FAIR
+			&& rq->curr != rq->idle)
+		min = rq->curr->vruntime;
+	if (!heap_empty (&rq->fair)) {
+		struct thread *left = heap_entry (heap_min (&rq->fair),
+				struct thread, fair_elem);
+
+		if (left->vruntime < min)
+			min = left->vruntime;
 	}
+	if (min != UINT64_MAX && min > rq->min_vruntime)
+		rq->min_vruntime = min;
+}
+
+static void
+fair_enqueue (struct runqueue *rq, struct thread *t) {
+	uint64_t floor = rq->min_vruntime > FAIR_SLEEPER_BONUS
+		? rq->min_vruntime - FAIR_SLEEPER_BONUS : 0;
+
+	if (t->vruntime < floor)
+		t->vruntime = floor;
+	heap_push (&rq->fair, &t->fair_elem);
+}
+
+static void
+fair_dequeue (struct runqueue *rq, struct thread *t) {
+	heap_remove (&rq->fair, &t->fair_elem);
+}
+
+static struct thread *
+fair_pick (struct runqueue *rq) {
+	if (heap_empty (&rq->fair))
+		return NULL;
+	return heap_entry (heap_min (&rq->fair), struct thread, fair_elem);
+}
+
+/* A fair thread is preempted once it is FAIR_GRANULARITY ahead
+   of the leftmost ready one, so that equal threads take turns a
+   tick or so apart instead of switching on every tick. */
+static bool
+fair_preempt (struct runqueue *rq, struct thread *curr) {
+	struct thread *left = fair_pick (rq);
+
+	return left != NULL && curr->vruntime > left->vruntime + FAIR_GRANULARITY;
+}
+
+static bool
+fair_tick (struct runqueue *rq, struct thread *curr) {
+	curr->vruntime += (uint64_t) NS_PER_TICK * FAIR_WEIGHT_NICE0
+		/ fair_weight (curr);
+	fair_update_min (rq);
+	return fair_preempt (rq, curr);
+}
+
+static const struct sched_class rt_class = {
+	rt_enqueue, rt_dequeue, rt_pick, rt_preempt, rt_tick,
+};
+static const struct sched_class prio_class = {
+	prio_enqueue, prio_dequeue, prio_pick, prio_preempt, prio_tick,
+};
+static const struct sched_class fair_class = {
+	fair_enqueue, fair_dequeue, fair_pick, fair_preempt, fair_tick,
+};
+
+/* Classes from highest to lowest rank. */
+#define SCHED_RANKS 3
+static const struct sched_class *const sched_classes[SCHED_RANKS] = {
+	&rt_class, &prio_class, &fair_class,
+};
+
+/* Returns the rank of POLICY's class in sched_classes[]. */
+static int
+sched_rank (enum sched_policy policy) {
+	switch (policy) {
+		case SCHED_FIFO:
+		case SCHED_RR:
+			return 0;
+		case SCHED_FAIR:
+			return 2;
+		default:
+			return 1;
+	}
+}
+
+/* Returns T's scheduling class. */
+static const struct sched_class *
+sched_class_of (const struct thread *t) {
+	return sched_classes[sched_rank (t->policy)];
+}
+
+/* Returns the thread RQ should run next, leaving it queued, or a
+   null pointer if RQ is empty.  The run queue must be locked. */
+static struct thread *
+ready_queue_pick (struct runqueue *rq) {
+	for (int rank = 0; rank < SCHED_RANKS; rank++) {
+		struct thread *t = sched_classes[rank]->pick (rq);
+
+		if (t != NULL)
+			return t;
+	}
+	return NULL;
+}
+
+/* Returns the MLFQS priority of T,
+   PRI_MAX - (recent_cpu / 4) - (nice * 2), clamped to the valid range. */
+static int
+mlfqs_priority (const struct thread *t) {
+	int priority = PRI_MAX - fp_to_int (fp_div_int (t->recent_cpu, 4))
+		- t->nice * 2;
+
+	if (priority < PRI_MIN)
+		return PRI_MIN;
+	if (priority > PRI_MAX)
+		return PRI_MAX;
+	return priority;
+}
+
+/* Applies the recent_cpu decay of every second T has missed since
+   its last refresh and recomputes its priority.  T must not be in
+   a run queue while its priority changes.  Each missed second is
+   recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice.
+   Seconds older than the history are replayed with the oldest
+   coefficient still kept; after another MLFQS_DECAY_HISTORY of
+   them recent_cpu has settled, so the rest are skipped. */
+static void
+mlfqs_refresh (struct thread *t) {
+	int64_t missed = mlfqs_epoch - t->cpu_epoch;
+	int64_t epoch;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (missed > MLFQS_DECAY_HISTORY) {
+		fixed_t oldest = mlfqs_decay[(mlfqs_epoch + 1) % MLFQS_DECAY_HISTORY];
+		int64_t extra = missed - MLFQS_DECAY_HISTORY;
+
+		if (extra > MLFQS_DECAY_HISTORY)
+			extra = MLFQS_DECAY_HISTORY;
+		while (extra-- > 0)
+			t->recent_cpu = fp_add_int (fp_mul (oldest, t->recent_cpu), t->nice);
+		missed = MLFQS_DECAY_HISTORY;
+	}
+	for (epoch = mlfqs_epoch - missed + 1; epoch <= mlfqs_epoch; epoch++)
+		t->recent_cpu = fp_add_int (fp_mul (mlfqs_decay[epoch
+					% MLFQS_DECAY_HISTORY], t->recent_cpu), t->nice);
+	t->cpu_epoch = mlfqs_epoch;
+	if (t->policy == SCHED_PRIO) {
+		t->priority = t->initial_priority = mlfqs_priority (t);
+		wait_queue_update (t);
+	}
+}
+
+/* Starts a new MLFQS second: updates load_avg, records this
+   second's decay coefficient and applies it to the running and
+   ready threads.  Ready threads are requeued in their old order,
+   highest priority first, so the run queue stays FIFO within each
+   new priority. */
+static void
+mlfqs_second (void) {
+	struct runqueue *rq = &runqueue;
+	int ready_threads = rq->cnt + (rq->curr != rq->idle);
+	fixed_t twice_load;
+	struct list requeue;
+
+	load_avg = fp_add (fp_div_int (fp_mul_int (load_avg, 59), 60),
+			fp_div_int (int_to_fp (ready_threads), 60));
+	twice_load = fp_mul_int (load_avg, 2);
+	mlfqs_decay[++mlfqs_epoch % MLFQS_DECAY_HISTORY] =
+		fp_div (twice_load, fp_add_int (twice_load, 1));
+
+	spinlock_acquire (&rq->lock);
+	if (rq->curr != rq->idle)
+		mlfqs_refresh (rq->curr);
+
+	/* Only SCHED_PRIO threads take their priority from the
+	   MLFQS; the others are refreshed when they unblock. */
+	list_init (&requeue);
+	while (rq->prio.mask != 0) {
+		struct list *queue =
+			&rq->prio.queues[63 - __builtin_clzll (rq->prio.mask)];
+
+		while (!list_empty (queue)) {
+			struct thread *r = list_entry (list_front (queue), struct thread, elem);
+
+			ready_queue_remove (r);
+			list_push_back (&requeue, &r->elem);
+		}
+	}
+	while (!list_empty (&requeue)) {
+		struct thread *r = list_entry (list_pop_front (&requeue),
+				struct thread, elem);
+
+		mlfqs_refresh (r);
+		ready_queue_push (r);
+	}
+	spinlock_release (&rq->lock);
+}
+
+/* MLFQS bookkeeping for one timer tick while T is running:
+   charges T one tick of recent_cpu, starts a new second every
+   TIMER_FREQ ticks and recomputes T's priority every TIME_SLICE
+   ticks, preempting it if a ready thread now outranks it. */
+static void
+mlfqs_tick (struct thread *t) {
+	if (!is_idle (t))
+		t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+
+	if (sched_ticks % TIMER_FREQ == 0)
+		mlfqs_second ();
+
+	if (sched_ticks % TIME_SLICE == 0 && t->policy == SCHED_PRIO
+			&& !is_idle (t)) {
+		t->priority = t->initial_priority = mlfqs_priority (t);
+		wait_queue_update (t);
+		if (preempt_by_priority ())
+			intr_yield_on_return ();
+	}
+}
+
+/* Repositions T in the semaphore, condition variable or rwlock waiters
+   heap it is queued in, if any, after its priority changed. */
+static void
+wait_queue_update (struct thread *t) {
+	if (t->wait_heap != NULL)
+		heap_update (t->wait_heap, t->wait_link);
+}
+
+/* Changes T's effective priority to PRIORITY.  A ready thread is
+   moved to the tail of its new priority's run queue, so donations
+   and priority changes never have to rescan the ready threads. */
+void
+thread_update_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
+
+	ASSERT (is_thread (t));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable ();
+	if (t->priority != priority) {
+		struct runqueue *rq = &runqueue;
+
+		spinlock_acquire (&rq->lock);
+		if (t->status == THREAD_READY) {
+			ready_queue_remove (t);
+			t->priority = priority;
+			ready_queue_push (t);
+		} else {
+			t->priority = priority;
+			wait_queue_update (t);
+		}
+		spinlock_release (&rq->lock);
+	}
+	intr_set_level (old_level);
 }
 
 /* Use iretq to launch the thread */
@@ -659,61 +1309,16 @@ do_iret (struct intr_frame *tf) {
    added at the end of the function. */
 static void
 thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
+	struct thread *curr = running_thread ();
 	ASSERT (intr_get_level () == INTR_OFF);
 
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
+	/* Only callee-saved registers and rsp need saving here: see
+	 * switch.S.  The full intr_frame and iretq are only needed to
+	 * start a thread that has never run. */
+	if (th->switch_rsp != 0)
+		switch_threads (&curr->switch_rsp, th->switch_rsp);
+	else
+		switch_first (&curr->switch_rsp, &th->tf);
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -727,30 +1332,13 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		if (!free_cache_put (&thread_cache, victim))
+			palloc_free_page(victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
 }
 
-/* depth 는 nested 의 최대 깊이를 지정해주기 위해 사용했다(max_depth = 8). 
-	스레드의 wait_on_lock 이 NULL 이 아니라면 스레드가 lock 에 걸려있다는 소리이므로 
-	그 lock 을 점유하고 있는 holder 스레드에게 priority 를 넘겨주는 방식을 깊이 8의 스레드까지 반복한다. 
-	wait_on_lock == NULL 이라면 더 이상 donation 을 진해할 필요가 없으므로 break 해준다. */
-void
-donate_priority (void)
-{ /* nest donation */
-  int depth;
-  struct thread *cur = thread_current ();
-
-  for (depth = 0; depth < 8; depth++){ // testcase가 최대 7까지 있어서 8로 설정
-    if (!cur->wait_on_lock) break;
-      struct thread *holder = cur->wait_on_lock->holder;
-      holder->priority = cur->priority;
-      cur = holder;
-  }
-}
-
 /* sheduling 함수는 thread_yield(), thread_block(), thread_exit() 함수 내의 거의 마지막 부분에 실행되어 
 	CPU 의 소유권을 현재 실행중인 스레드에서 다음에 실행될 스레드로 넘겨주는 작업을 한다. */
 static void
@@ -779,6 +1367,14 @@ schedule (void) {
 	/* Start new time slice. */
 	thread_ticks = 0;
 
+	/* The idle thread may have stopped the periodic tick that
+	   enforces the new thread's time slice. */
+	if (is_idle (curr) && !is_idle (next))
+		timer_idle_exit ();
+
+	if (thread_schedlat)
+		schedlat_switch (&runqueue, curr, next);
+
 #ifdef USERPROG
 	/* Activate the new address space. */
 	process_activate (next);
@@ -799,6 +1395,142 @@ schedule (void) {
 	}
 }
 
+/* Timestamps CURR being switched out and NEXT being switched in
+   on run queue RQ, recording how long NEXT waited to run. */
+static void
+schedlat_switch (struct runqueue *rq, struct thread *curr,
+		struct thread *next) {
+	uint64_t now = rdtsc ();
+
+	/* A preempted or yielding thread is ready from now on. */
+	if (curr->status == THREAD_READY)
+		curr->ready_tsc = now;
+
+	if (is_idle (next) || next->ready_tsc == 0)
+		return;
+	hist_add (&rq->wait_hist, now - next->ready_tsc);
+	if (next->latency != NULL)
+		hist_add (&next->latency->wait, now - next->ready_tsc);
+	if (next->wake_tsc != 0) {
+		hist_add (&rq->wakeup_hist, now - next->wake_tsc);
+		if (next->latency != NULL)
+			hist_add (&next->latency->wakeup, now - next->wake_tsc);
+		next->wake_tsc = 0;
+	}
+}
+
+/* Initializes C as an empty cache of at most MAX blocks, called
+   NAME for -lockstat. */
+static void
+free_cache_init (struct free_cache *c, int max, const char *name) {
+	spinlock_init_named (&c->lock, name);
+	c->head = NULL;
+	c->cnt = 0;
+	c->max = max;
+}
+
+/* Removes and returns a block from C, or a null pointer if C is
+   empty. */
+static void *
+free_cache_get (struct free_cache *c) {
+	void *block;
+
+	spinlock_acquire (&c->lock);
+	block = c->head;
+	if (block != NULL) {
+		c->head = *(void **) block;
+		c->cnt--;
+	}
+	spinlock_release (&c->lock);
+	return block;
+}
+
+/* Adds BLOCK to C and returns true, or returns false if C is
+   full, in which case the caller must free BLOCK itself.
+   Overwrites the first word of BLOCK. */
+static bool
+free_cache_put (struct free_cache *c, void *block) {
+	bool cached;
+
+	spinlock_acquire (&c->lock);
+	cached = c->cnt < c->max;
+	if (cached) {
+		*(void **) block = c->head;
+		c->head = block;
+		c->cnt++;
+	}
+	spinlock_release (&c->lock);
+	return cached;
+}
+
+/* Empties C, each of whose blocks is PAGE_CNT pages, giving the
+   blocks back to palloc, and returns the number of pages freed.
+   The blocks are unlinked under C's lock but freed after it is
+   released, because palloc_free_multiple() takes the pool lock. */
+static size_t
+free_cache_shrink (struct free_cache *c, size_t page_cnt) {
+	void *block;
+	size_t freed = 0;
+
+	spinlock_acquire (&c->lock);
+	block = c->head;
+	c->head = NULL;
+	c->cnt = 0;
+	spinlock_release (&c->lock);
+
+	while (block != NULL) {
+		void *next = *(void **) block;
+
+		palloc_free_multiple (block, page_cnt);
+		freed += page_cnt;
+		block = next;
+	}
+	return freed;
+}
+
+/* Gives the pages cached in thread_cache and fdt_cache back to
+   palloc.  Called by palloc when the kernel pool runs out of
+   memory; returns true if any page was freed, so that the
+   allocation is worth retrying. */
+bool
+thread_shrink_caches (void) {
+	size_t freed = free_cache_shrink (&thread_cache, 1);
+
+	freed += free_cache_shrink (&fdt_cache, FDT_PAGES);
+	return freed > 0;
+}
+
+/* Returns a file descriptor table of FDCOUNT_LIMIT entries, all
+   null except the dummy STDIN and STDOUT entries, or a null
+   pointer if memory is exhausted.  User processes call this on
+   their first open(), so kernel threads never pay for one. */
+struct file **
+thread_fdt_alloc (void) {
+	struct file **fdt = free_cache_get (&fdt_cache);
+
+	if (fdt == NULL) {
+		fdt = palloc_get_multiple (PAL_ZERO, FDT_PAGES);
+		if (fdt == NULL)
+			return NULL;
+	}
+	fdt[0] = (struct file *) 1; /* dummy value for STDIN */
+	fdt[1] = (struct file *) 2; /* dummy value for STDOUT */
+	return fdt;
+}
+
+/* Frees FDT, which was returned by thread_fdt_alloc().  Every
+   descriptor other than STDIN and STDOUT must already be closed,
+   so that a cached table only needs its first two entries
+   cleared to be reused. */
+void
+thread_fdt_free (struct file **fdt) {
+	if (fdt == NULL)
+		return;
+	fdt[0] = fdt[1] = NULL;
+	if (!free_cache_put (&fdt_cache, fdt))
+		palloc_free_multiple (fdt, FDT_PAGES);
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
@@ -822,41 +1554,81 @@ void thread_sleep(int64_t ticks){
 	old_level = intr_disable ();
 	curr = thread_current ();
 
-	ASSERT(curr != idle_thread)
+	ASSERT(!is_idle (curr));
 	
-	if (next_tick_to_awake>ticks){
-		next_tick_to_awake = ticks;
-	} 
-	curr->wake_up_tick = ticks;
-	list_push_back (&sleep_list, &curr->elem);	
-	thread_block();
+	thread_block_until (ticks);
 	intr_set_level (old_level);
 }
 
-/* make thread awake in timer_interrupt() (../device/timer.c) */
+/* blocks the running thread like thread_block(), and also puts it on the
+	sleep heap until tick UNTIL unless UNTIL is INT64_MAX.  the thread runs
+	again at UNTIL or when thread_wake() is called on it, whichever is first.
+	interrupts must be off. */
+void thread_block_until (int64_t until) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (until != INT64_MAX) {
+		curr->wake_up_tick = until;
+		curr->sleeping = true;
+		heap_push (&sleep_heap, &curr->sleep_elem);
+		next_tick_to_awake = heap_entry (heap_min (&sleep_heap),
+				struct thread, sleep_elem)->wake_up_tick;
+	}
+	thread_block ();
+}
+
+/* unblocks T, blocked in thread_block_until(), before its wake up tick.
+	interrupts must be off. */
+void thread_wake (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t->sleeping) {
+		heap_remove (&sleep_heap, &t->sleep_elem);
+		t->sleeping = false;
+		next_tick_to_awake = heap_empty (&sleep_heap) ? INT64_MAX
+			: heap_entry (heap_min (&sleep_heap), struct thread,
+					sleep_elem)->wake_up_tick;
+	}
+	thread_unblock (t);
+}
+
+/* make thread awake in timer_interrupt() (../device/timer.c)
+	only threads that are due are touched: they are popped off the sleep heap
+	in wake_up_tick order, and the whole batch shares one preemption check. */
 void thread_awake(int64_t ticks){
-	next_tick_to_awake = INT64_MAX;
-	enum intr_level old_level;
-	struct list_elem *e;
+	bool woken = false;
 	ASSERT (intr_context ());
 
-	for (e = list_begin (&sleep_list); e != list_end (&sleep_list);) {
-		struct thread* t = list_entry(e, struct thread, elem);
-	
-		if (t->wake_up_tick <= ticks) {
-			e = list_remove(e);
-			thread_unblock(t);
-			if (preempt_by_priority()){
-				intr_yield_on_return();
-			}
-		}
-		else {
-			if (t->wake_up_tick<next_tick_to_awake){
-				next_tick_to_awake = t->wake_up_tick;
-			}
-			e = list_next(e);
+	next_tick_to_awake = INT64_MAX;
+	while (!heap_empty (&sleep_heap)) {
+		struct thread *t = heap_entry (heap_min (&sleep_heap),
+				struct thread, sleep_elem);
+
+		if (t->wake_up_tick > ticks) {
+			next_tick_to_awake = t->wake_up_tick;
+			break;
 		}
+		heap_pop (&sleep_heap);
+		t->sleeping = false;
+		if (thread_schedlat)
+			t->wake_tsc = rdtsc () - (uint64_t) (ticks - t->wake_up_tick)
+				* timer_tsc_per_tick ();
+		thread_unblock (t);
+		woken = true;
 	}
+
+	if (woken && preempt_by_priority ())
+		intr_yield_on_return ();
+}
+
+/* orders sleeping threads by wake_up_tick for sleep_heap */
+static bool
+thread_wake_up_tick_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, sleep_elem)->wake_up_tick
+		< heap_entry (b, struct thread, sleep_elem)->wake_up_tick;
 }
 
 /* global function to get value of next_tick_to_awake */
@@ -865,27 +1637,28 @@ int64_t get_next_tick_to_awake(void) {
 }
 
 
-/* compare priority between running thread and highest priority thread in ready_list 
-	if running thread priority < highest priority thread in ready_list , return true */
+/* compare running thread with the ready threads in run queue
+	a ready thread of a higher scheduling class always preempts; within the
+	running thread's class the class decides (priority, or vruntime lead).
+	the idle thread is preempted by any ready thread. */
 bool preempt_by_priority(void) {
-	int curr_priority;
-	struct thread *max_ready_thread;
-	struct list_elem *max_ready_elem;
-
-	curr_priority = thread_get_priority();
-
-	if (list_empty(&ready_list))return false; /* !! if ready list is empty, return false directly !!*/
-
-	list_sort(&ready_list, &thread_priority_compare, NULL);
-	max_ready_elem = list_begin(&ready_list);
-	max_ready_thread = list_entry(max_ready_elem, struct thread, elem);
+	struct runqueue *rq = &runqueue;
+	struct thread *curr = running_thread ();
+	bool preempt = false;
 
-	if (curr_priority < max_ready_thread->priority) {
-		return true;
-	}
+	spinlock_acquire (&rq->lock);
+	if (is_idle (curr))
+		preempt = rq->cnt > 0;
 	else {
-		return false;
+		int rank = sched_rank (curr->policy);
+
+		for (int r = 0; r < rank && !preempt; r++)
+			preempt = sched_classes[r]->pick (rq) != NULL;
+		if (!preempt)
+			preempt = sched_classes[rank]->preempt (rq, curr);
 	}
+	spinlock_release (&rq->lock);
+	return preempt;
 }
 
 /* compare threads' priority of element1 and element2 by **elem** in struct thread */
@@ -900,18 +1673,6 @@ bool thread_priority_compare (struct list_elem *element1, struct list_elem *elem
 	}
 }
 
-/* compare threads' priority of element1 and element2 by **donation_elem** in struct thread */
-bool thread_donate_priority_compare (struct list_elem *element1, struct list_elem *element2, void *aux UNUSED) {
-	struct thread *t1 = list_entry(element1, struct thread, donation_elem);
-	struct thread *t2 = list_entry(element2, struct thread, donation_elem);
-
-	if (t1->priority>t2->priority){
-		return true;
-	}else{
-		return false;
-	}
-}
-
 /* ------------------- project 1 functions end ------------------------------- */
 
 /* --------------------- project 2 ------------------------ */
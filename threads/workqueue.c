@@ -0,0 +1,460 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Kernel workqueue.
+
+   Work is queued on one FIFO list per priority and run by a pool
+   of kernel worker threads, "kworker/N", which always start the
+   highest priority work first.  Work may be queued from interrupt
+   handlers, so all state is protected by a spinlock rather than a
+   lock, and the pool is only grown from thread context.
+
+   The pool starts with WQ_MIN_WORKERS threads.  Whenever a worker
+   takes work while more is pending and no other worker is idle,
+   it first starts another, up to WQ_MAX_WORKERS, so that work
+   that blocks (on disk I/O, say) does not hold up the rest.  A
+   worker that runs out of work exits if WQ_MAX_IDLE others are
+   already idle.
+
+   Delayed work waits in a heap ordered by expiry tick until the
+   timer interrupt moves it onto its queue, the same way sleeping
+   threads are woken.
+
+   sema_up() may yield, which must not happen while wq_lock is
+   held, so waiters to wake are collected on a list under the lock
+   and woken once it is released. */
+
+#define WQ_MIN_WORKERS 1        /* Workers kept even when idle. */
+#define WQ_MAX_WORKERS 8        /* Max # of workers. */
+#define WQ_MAX_IDLE 2           /* Max # of idle workers kept. */
+
+/* Thread priority a worker runs each priority's work at. */
+static const int work_thread_priority[WORK_PRI_CNT] = {
+	[WORK_PRI_HIGH] = PRI_DEFAULT + 1,
+	[WORK_PRI_NORMAL] = PRI_DEFAULT,
+	[WORK_PRI_LOW] = PRI_DEFAULT - 10,
+};
+
+/* A thread blocked in the workqueue. */
+struct waiter {
+	struct list_elem elem;      /* Element in a list of waiters. */
+	struct semaphore sema;      /* Upped to wake it. */
+};
+
+/* A worker thread.  Lives on the worker's own stack. */
+struct worker {
+	struct list_elem elem;      /* Element in `workers'. */
+	struct waiter idle;         /* In `idle_workers' while idle. */
+	void *current;              /* Work being run, or null. */
+};
+
+/* A thread waiting in flush_work() or flush_workqueue(). */
+struct flusher {
+	struct waiter waiter;       /* In `flushers' while waiting. */
+	struct work *work;          /* Work waited for, or null for all. */
+};
+
+static struct spinlock wq_lock;     /* Protects everything below. */
+static struct list queues[WORK_PRI_CNT]; /* Pending work, by priority. */
+static int pending_cnt;             /* # of works in `queues'. */
+static struct heap delayed;         /* Delayed works, soonest first. */
+static int64_t next_delayed_tick;   /* Expiry of delayed's first. */
+static struct list workers;         /* All workers. */
+static struct list idle_workers;    /* struct waiter of idle workers. */
+static int worker_cnt;              /* # of workers, counting ones starting. */
+static int running_cnt;             /* # of workers running a work. */
+static struct list flushers;        /* struct waiter of each flusher. */
+static unsigned worker_seq;         /* Numbers worker names. */
+
+static void worker_main (void *aux);
+static bool worker_spawn (void);
+static struct work *dequeue_work (void);
+static void enqueue_work (struct work *, struct list *wake);
+static bool work_busy (const struct work *);
+static void wake_flushers (const struct work *, struct list *wake);
+static void waiters_wake (struct list *);
+static void flusher_wait (struct flusher *);
+static bool work_expires_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+
+/* Initializes the workqueue and starts its first workers.  Must
+   be called after thread_start(). */
+void
+workqueue_init (void) {
+	spinlock_init (&wq_lock);
+	for (int pri = 0; pri < WORK_PRI_CNT; pri++)
+		list_init (&queues[pri]);
+	heap_init (&delayed, work_expires_less, NULL);
+	next_delayed_tick = INT64_MAX;
+	list_init (&workers);
+	list_init (&idle_workers);
+	list_init (&flushers);
+
+	for (int i = 0; i < WQ_MIN_WORKERS; i++) {
+		spinlock_acquire (&wq_lock);
+		worker_cnt++;
+		spinlock_release (&wq_lock);
+		if (!worker_spawn ())
+			PANIC ("workqueue: cannot start worker");
+	}
+}
+
+/* Initializes W to call FUNC with AUX at PRIORITY. */
+void
+work_init (struct work *w, enum work_priority priority, work_func *func,
+		void *aux) {
+	ASSERT (w != NULL);
+	ASSERT (priority < WORK_PRI_CNT);
+	ASSERT (func != NULL);
+
+	w->func = func;
+	w->aux = aux;
+	w->priority = priority;
+	w->pending = false;
+	w->delayed = false;
+}
+
+/* Queues W to be run by a worker thread.  Returns false, doing
+   nothing, if W is already pending.  May be called from an
+   interrupt handler. */
+bool
+queue_work (struct work *w) {
+	struct list wake;
+	bool grow;
+
+	list_init (&wake);
+	spinlock_acquire (&wq_lock);
+	if (w->pending) {
+		spinlock_release (&wq_lock);
+		return false;
+	}
+	w->pending = true;
+
+	/* Every worker is busy: grow the pool, unless we cannot
+	   create a thread here. */
+	grow = list_empty (&idle_workers) && worker_cnt < WQ_MAX_WORKERS
+		&& !intr_context ();
+	if (grow)
+		worker_cnt++;
+	enqueue_work (w, &wake);
+	spinlock_release (&wq_lock);
+
+	waiters_wake (&wake);
+	if (grow)
+		worker_spawn ();
+	return true;
+}
+
+/* Queues W to be run by a worker thread in TICKS timer ticks, or
+   at once if TICKS is not positive.  Returns false, doing
+   nothing, if W is already pending.  May be called from an
+   interrupt handler. */
+bool
+queue_delayed_work (struct work *w, int64_t ticks) {
+	if (ticks <= 0)
+		return queue_work (w);
+
+	spinlock_acquire (&wq_lock);
+	if (w->pending) {
+		spinlock_release (&wq_lock);
+		return false;
+	}
+	w->pending = w->delayed = true;
+	w->expires = timer_ticks () + ticks;
+	heap_push (&delayed, &w->timer_elem);
+	next_delayed_tick = heap_entry (heap_min (&delayed), struct work,
+			timer_elem)->expires;
+	spinlock_release (&wq_lock);
+	return true;
+}
+
+/* Removes W from the workqueue if it is pending.  Returns true if
+   it was.  W may still be running when this returns; see
+   cancel_work_sync(). */
+bool
+cancel_work (struct work *w) {
+	struct list wake;
+	bool was_pending;
+
+	list_init (&wake);
+	spinlock_acquire (&wq_lock);
+	was_pending = w->pending;
+	if (was_pending) {
+		if (w->delayed) {
+			heap_remove (&delayed, &w->timer_elem);
+			next_delayed_tick = heap_empty (&delayed) ? INT64_MAX
+				: heap_entry (heap_min (&delayed), struct work,
+						timer_elem)->expires;
+		} else {
+			list_remove (&w->elem);
+			pending_cnt--;
+		}
+		w->pending = w->delayed = false;
+		wake_flushers (w, &wake);
+	}
+	spinlock_release (&wq_lock);
+	waiters_wake (&wake);
+	return was_pending;
+}
+
+/* Like cancel_work(), but also waits for W to finish if it is
+   running, so that W may be freed afterward.  Must not be called
+   from W's own function. */
+bool
+cancel_work_sync (struct work *w) {
+	bool was_pending = cancel_work (w);
+
+	flush_work (w);
+	return was_pending;
+}
+
+/* Waits until W is neither pending nor running.  Delayed work is
+   waited for too, expiry and all. */
+void
+flush_work (struct work *w) {
+	struct flusher f;
+
+	ASSERT (!intr_context ());
+
+	f.work = w;
+	sema_init_named (&f.waiter.sema, 0, NULL);
+	spinlock_acquire (&wq_lock);
+	while (work_busy (w))
+		flusher_wait (&f);
+	spinlock_release (&wq_lock);
+}
+
+/* Waits until no work is queued or running.  Delayed work that
+   has not expired yet is not waited for. */
+void
+flush_workqueue (void) {
+	struct flusher f;
+
+	ASSERT (!intr_context ());
+
+	f.work = NULL;
+	sema_init_named (&f.waiter.sema, 0, NULL);
+	spinlock_acquire (&wq_lock);
+	while (pending_cnt > 0 || running_cnt > 0)
+		flusher_wait (&f);
+	spinlock_release (&wq_lock);
+}
+
+/* Blocks F until a worker wakes it, dropping wq_lock, which must
+   be held, meanwhile. */
+static void
+flusher_wait (struct flusher *f) {
+	list_push_back (&flushers, &f->waiter.elem);
+	spinlock_release (&wq_lock);
+	sema_down (&f->waiter.sema);
+	spinlock_acquire (&wq_lock);
+}
+
+/* Returns the tick at which the next delayed work expires, or
+   INT64_MAX if there is none.  Read without locking, as a hint
+   for the timer interrupt and the idle thread. */
+int64_t
+workqueue_next_tick (void) {
+	return next_delayed_tick;
+}
+
+/* Queues every delayed work that has expired by TICKS.  Called
+   by the timer interrupt handler. */
+void
+workqueue_timer (int64_t ticks) {
+	struct list wake;
+
+	ASSERT (intr_context ());
+
+	list_init (&wake);
+	spinlock_acquire (&wq_lock);
+	next_delayed_tick = INT64_MAX;
+	while (!heap_empty (&delayed)) {
+		struct work *w = heap_entry (heap_min (&delayed), struct work,
+				timer_elem);
+
+		if (w->expires > ticks) {
+			next_delayed_tick = w->expires;
+			break;
+		}
+		heap_pop (&delayed);
+		w->delayed = false;
+		enqueue_work (w, &wake);
+	}
+	spinlock_release (&wq_lock);
+	waiters_wake (&wake);
+}
+
+/* Appends pending W to its priority's queue and moves an idle
+   worker, if there is one, to WAKE.  wq_lock must be held. */
+static void
+enqueue_work (struct work *w, struct list *wake) {
+	ASSERT (spinlock_held (&wq_lock));
+
+	list_push_back (&queues[w->priority], &w->elem);
+	pending_cnt++;
+	if (!list_empty (&idle_workers))
+		list_push_back (wake, list_pop_front (&idle_workers));
+}
+
+/* Removes and returns the oldest work of the highest priority
+   that has any, or a null pointer if none is pending.  wq_lock
+   must be held. */
+static struct work *
+dequeue_work (void) {
+	ASSERT (spinlock_held (&wq_lock));
+
+	for (int pri = 0; pri < WORK_PRI_CNT; pri++)
+		if (!list_empty (&queues[pri])) {
+			pending_cnt--;
+			return list_entry (list_pop_front (&queues[pri]), struct work, elem);
+		}
+	return NULL;
+}
+
+/* Returns true if W is pending or some worker is running it.
+   wq_lock must be held. */
+static bool
+work_busy (const struct work *w) {
+	struct list_elem *e;
+
+	ASSERT (spinlock_held (&wq_lock));
+
+	if (w->pending)
+		return true;
+	for (e = list_begin (&workers); e != list_end (&workers); e = list_next (e))
+		if (list_entry (e, struct worker, elem)->current == w)
+			return true;
+	return false;
+}
+
+/* Moves to WAKE the threads flushing W, which may be dangling by
+   now and is only compared, and those flushing the whole
+   workqueue if it has drained.  Woken threads check again for
+   themselves.  wq_lock must be held. */
+static void
+wake_flushers (const struct work *w, struct list *wake) {
+	bool drained = pending_cnt == 0 && running_cnt == 0;
+	struct list_elem *e;
+
+	ASSERT (spinlock_held (&wq_lock));
+
+	for (e = list_begin (&flushers); e != list_end (&flushers); ) {
+		struct flusher *f = list_entry (e, struct flusher, waiter.elem);
+
+		if (f->work == w || (f->work == NULL && drained)) {
+			e = list_remove (e);
+			list_push_back (wake, &f->waiter.elem);
+		} else
+			e = list_next (e);
+	}
+}
+
+/* Wakes each struct waiter on WAKE.  wq_lock must not be held:
+   a woken waiter may preempt us. */
+static void
+waiters_wake (struct list *wake) {
+	while (!list_empty (wake)) {
+		struct waiter *waiter = list_entry (list_pop_front (wake),
+				struct waiter, elem);
+
+		sema_up (&waiter->sema);
+	}
+}
+
+/* Starts a new worker, already counted in worker_cnt.  Returns
+   false, uncounting it, if no thread could be created. */
+static bool
+worker_spawn (void) {
+	char name[16];
+
+	snprintf (name, sizeof name, "kworker/%u", worker_seq++);
+	if (thread_create (name, PRI_DEFAULT, worker_main, NULL) != TID_ERROR)
+		return true;
+
+	spinlock_acquire (&wq_lock);
+	worker_cnt--;
+	spinlock_release (&wq_lock);
+	return false;
+}
+
+/* Worker thread: runs pending work until there is none, then
+   waits for more or exits if enough other workers are idle. */
+static void
+worker_main (void *aux UNUSED) {
+	struct worker self;
+	struct work *w = NULL;
+
+	sema_init (&self.idle.sema, 0);
+	self.current = NULL;
+
+	spinlock_acquire (&wq_lock);
+	list_push_back (&workers, &self.elem);
+	spinlock_release (&wq_lock);
+
+	for (;;) {
+		struct list wake;
+		work_func *func;
+		void *func_aux;
+		int priority;
+		bool grow;
+
+		list_init (&wake);
+		spinlock_acquire (&wq_lock);
+		if (w != NULL) {
+			self.current = NULL;
+			running_cnt--;
+			wake_flushers (w, &wake);
+		}
+
+		while ((w = dequeue_work ()) == NULL) {
+			if (worker_cnt > WQ_MIN_WORKERS
+					&& (int) list_size (&idle_workers) >= WQ_MAX_IDLE) {
+				list_remove (&self.elem);
+				worker_cnt--;
+				spinlock_release (&wq_lock);
+				waiters_wake (&wake);
+				return;
+			}
+			list_push_back (&idle_workers, &self.idle.elem);
+			spinlock_release (&wq_lock);
+			waiters_wake (&wake);
+			sema_down (&self.idle.sema);
+			spinlock_acquire (&wq_lock);
+		}
+
+		/* W may be queued again, or freed, once its function
+		   starts, so copy out what we need first. */
+		w->pending = false;
+		func = w->func;
+		func_aux = w->aux;
+		priority = work_thread_priority[w->priority];
+		self.current = w;
+		running_cnt++;
+
+		grow = pending_cnt > 0 && list_empty (&idle_workers)
+			&& worker_cnt < WQ_MAX_WORKERS;
+		if (grow)
+			worker_cnt++;
+		spinlock_release (&wq_lock);
+
+		waiters_wake (&wake);
+		if (grow)
+			worker_spawn ();
+		thread_set_priority (priority);
+		func (func_aux);
+	}
+}
+
+/* Orders delayed works by expiry tick. */
+static bool
+work_expires_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct work, timer_elem)->expires
+		< heap_entry (b, struct work, timer_elem)->expires;
+}
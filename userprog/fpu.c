@@ -0,0 +1,237 @@
+#include "userprog/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "userprog/gdt.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "intrinsic.h"
+
+/* Lazy FPU/SSE state switching.
+
+   The kernel itself is built without SSE or x87 code, so only
+   user programs touch the FPU, and most of them never do.  A
+   thread gets a save area, `fpu' in struct thread, the first time
+   it executes an FPU instruction, and the registers are saved and
+   restored only when a thread that uses them runs after another
+   that did:
+
+   fpu_activate() sets CR0.TS on every switch to a thread other
+   than `fpu_owner', the thread whose state is in the registers.
+   Its next FPU instruction then raises #NM, upon which fpu_trap()
+   saves the registers to the owner's area, loads the current
+   thread's, and clears TS.  Switching back to the owner before
+   anyone else used the FPU costs nothing at all.
+
+   The registers are saved with XSAVE, which covers AVX too, if
+   the CPU has it, and with FXSAVE (x87 and SSE only) otherwise. */
+
+/* CR0 and CR4 bits. */
+#define CR0_MP (1 << 1)             /* Monitor coprocessor: WAIT traps on TS. */
+#define CR0_EM (1 << 2)             /* Emulate FPU: every FPU op traps. */
+#define CR0_TS (1 << 3)             /* Task switched: next FPU op traps. */
+#define CR0_NE (1 << 5)             /* Report FPU errors as #MF. */
+#define CR4_OSFXSR (1 << 9)         /* Enable SSE and FXSAVE. */
+#define CR4_OSXMMEXCPT (1 << 10)    /* Report SSE errors as #XF. */
+#define CR4_OSXSAVE (1 << 18)       /* Enable XSAVE and XCR0. */
+
+/* CPUID feature bits. */
+#define CPUID_1_EDX_FXSR (1 << 24)
+#define CPUID_1_ECX_XSAVE (1 << 26)
+
+/* State components we enable in XCR0. */
+#define XSTATE_X87 (1 << 0)
+#define XSTATE_SSE (1 << 1)
+#define XSTATE_AVX (1 << 2)
+
+#define FXSAVE_SIZE 512
+#define FPU_ALIGN 64                /* XSAVE needs 64, FXSAVE 16. */
+
+/* Control words of a freshly initialized FPU: every exception
+   masked, as after FNINIT and at reset. */
+#define FPU_INIT_FCW 0x037f
+#define FPU_INIT_MXCSR 0x1f80
+
+static bool use_xsave;              /* XSAVE rather than FXSAVE? */
+static uint64_t xstate_mask;        /* Components XSAVE saves. */
+static size_t fpu_size;             /* Bytes in a save area. */
+
+/* Thread whose state is in the FPU registers, or null. */
+static struct thread *fpu_owner;
+
+/* Mirror of CR0.TS, to skip writing CR0 when it would not change. */
+static bool fpu_ts;
+
+static void fpu_trap (struct intr_frame *);
+
+/* Sets CR0.TS to TS. */
+static void
+fpu_set_ts (bool ts) {
+	if (ts == fpu_ts)
+		return;
+	if (ts)
+		lcr0 (rcr0 () | CR0_TS);
+	else
+		clts ();
+	fpu_ts = ts;
+}
+
+/* Returns T's save area, aligned as XSAVE needs. */
+static void *
+fpu_area (struct thread *t) {
+	return (void *) ROUND_UP ((uintptr_t) t->fpu, FPU_ALIGN);
+}
+
+/* Stores the FPU registers in AREA. */
+static void
+fpu_save (void *area) {
+	if (use_xsave)
+		asm volatile ("xsave64 (%0)"
+				: : "r" (area), "a" ((uint32_t) xstate_mask),
+				"d" ((uint32_t) (xstate_mask >> 32)) : "memory");
+	else
+		asm volatile ("fxsave64 (%0)" : : "r" (area) : "memory");
+}
+
+/* Loads the FPU registers from AREA. */
+static void
+fpu_restore (const void *area) {
+	if (use_xsave)
+		asm volatile ("xrstor64 (%0)"
+				: : "r" (area), "a" ((uint32_t) xstate_mask),
+				"d" ((uint32_t) (xstate_mask >> 32)) : "memory");
+	else
+		asm volatile ("fxrstor64 (%0)" : : "r" (area) : "memory");
+}
+
+/* Turns on the FPU and SSE for user programs and installs the
+   device-not-available (#NM) handler that switches their state. */
+void
+fpu_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if ((edx & CPUID_1_EDX_FXSR) == 0)
+		PANIC ("CPU lacks FXSAVE");
+	use_xsave = (ecx & CPUID_1_ECX_XSAVE) != 0;
+
+	lcr0 ((rcr0 () & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+	fpu_ts = true;
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT
+			| (use_xsave ? CR4_OSXSAVE : 0));
+
+	fpu_size = FXSAVE_SIZE;
+	if (use_xsave) {
+		/* EAX:EDX of leaf 0xd lists the components the CPU supports,
+		   and EBX is the XSAVE area size for those set in XCR0. */
+		cpuid (0xd, &eax, &ebx, &ecx, &edx);
+		xstate_mask = eax & (XSTATE_X87 | XSTATE_SSE | XSTATE_AVX);
+		xsetbv (0, xstate_mask);
+		cpuid (0xd, &eax, &ebx, &ecx, &edx);
+		fpu_size = ebx;
+	}
+
+	intr_register_int (7, 0, INTR_ON, fpu_trap,
+			"#NM Device Not Available Exception");
+}
+
+/* Called on every switch to NEXT: lets it use the FPU directly if
+   its state is loaded, and makes it trap first otherwise. */
+void
+fpu_activate (struct thread *next) {
+	fpu_set_ts (next != fpu_owner);
+}
+
+/* Returns a new save area holding the state of a freshly
+   initialized FPU, or a null pointer if out of memory. */
+static void *
+fpu_alloc (void) {
+	void *raw = malloc (fpu_size + FPU_ALIGN - 1);
+	uint8_t *area;
+
+	if (raw == NULL)
+		return NULL;
+	/* An all-zero XSAVE header marks every component as being in
+	   its initial state, except MXCSR, which is always loaded. */
+	area = (uint8_t *) ROUND_UP ((uintptr_t) raw, FPU_ALIGN);
+	memset (area, 0, fpu_size);
+	*(uint16_t *) (area + 0) = FPU_INIT_FCW;
+	*(uint32_t *) (area + 24) = FPU_INIT_MXCSR;
+	return raw;
+}
+
+/* #NM handler: the current thread used the FPU with CR0.TS set. */
+static void
+fpu_trap (struct intr_frame *f) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	if (f->cs != SEL_UCSEG) {
+		intr_dump_frame (f);
+		PANIC ("Kernel bug - FPU used in kernel");
+	}
+
+	/* First use: malloc() may sleep, so do it with interrupts on. */
+	if (curr->fpu == NULL) {
+		curr->fpu = fpu_alloc ();
+		if (curr->fpu == NULL) {
+			printf ("%s: out of memory for FPU state\n", thread_name ());
+			curr->exit_status = -1;
+			thread_exit ();
+		}
+	}
+
+	old_level = intr_disable ();
+	fpu_set_ts (false);
+	if (fpu_owner != curr) {
+		if (fpu_owner != NULL)
+			fpu_save (fpu_area (fpu_owner));
+		fpu_restore (fpu_area (curr));
+		fpu_owner = curr;
+	}
+	intr_set_level (old_level);
+}
+
+/* Gives DST, a new thread forked from SRC, a copy of SRC's FPU
+   state.  Returns false if out of memory. */
+bool
+fpu_copy (struct thread *dst, struct thread *src) {
+	enum intr_level old_level;
+
+	ASSERT (dst->fpu == NULL);
+	if (src->fpu == NULL)
+		return true;
+
+	dst->fpu = malloc (fpu_size + FPU_ALIGN - 1);
+	if (dst->fpu == NULL)
+		return false;
+
+	old_level = intr_disable ();
+	if (fpu_owner == src) {
+		/* SRC's latest state is still in the registers. */
+		fpu_set_ts (false);
+		fpu_save (fpu_area (src));
+		fpu_activate (thread_current ());
+	}
+	memcpy (fpu_area (dst), fpu_area (src), fpu_size);
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Discards T's FPU state, for exit or exec.  The next FPU use by T,
+   if any, starts over from a freshly initialized FPU. */
+void
+fpu_free (struct thread *t) {
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	if (fpu_owner == t) {
+		fpu_owner = NULL;
+		fpu_activate (thread_current ());
+	}
+	intr_set_level (old_level);
+
+	free (t->fpu);
+	t->fpu = NULL;
+}
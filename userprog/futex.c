@@ -0,0 +1,219 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "userprog/process.h"
+
+/* Fast user-space mutexes.
+
+   A user program keeps its lock state in an ordinary int and
+   calls futex_wait() only to sleep while the int holds a value
+   meaning "contended", and futex_wake() only when it knows there
+   may be sleepers, so an uncontended lock never enters the kernel.
+
+   Waiters are keyed by the kernel address of the frame holding
+   the int, that is, by physical memory, so processes sharing a
+   frame wait on the same futex.  A frame that is evicted while
+   threads wait on it changes key, so wakers may miss them; callers
+   that cannot rule that out should wait with a timeout.
+
+   Each key hashes to one of FUTEX_BUCKETS buckets, whose lock
+   makes checking the value and queueing the waiter atomic with
+   respect to futex_wake(). */
+#define FUTEX_BUCKETS 64
+
+struct futex_bucket {
+	struct lock lock;           /* Protects `waiters'. */
+	struct list waiters;        /* struct futex_waiter of each waiter. */
+};
+
+/* A thread in futex_wait().  Lives on its stack. */
+struct futex_waiter {
+	struct list_elem elem;      /* Element in its bucket's `waiters'. */
+	void *key;                  /* Kernel address of the futex. */
+	struct thread *thread;      /* The waiting thread. */
+	bool blocked;               /* In thread_block_until()? */
+	bool woken;                 /* Woken by futex_wake()? */
+};
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+static void *futex_key (int *uaddr, struct futex_bucket **);
+
+/* Initializes the futex buckets. */
+void
+futex_init (void) {
+	for (int i = 0; i < FUTEX_BUCKETS; i++) {
+		lock_init (&buckets[i].lock);
+		list_init (&buckets[i].waiters);
+	}
+}
+
+/* If *UADDR equals EXPECTED, sleeps until futex_wake() is called
+   on the same futex or, if TIMEOUT_MS is not negative, until that
+   many milliseconds pass.  Returns 0 if woken by futex_wake(), or
+   -1 if *UADDR did not equal EXPECTED, on timeout, if UADDR is not
+   a valid, aligned user address, or if the process is exiting.
+   Callers must check their condition again either way. */
+int
+futex_wait (int *uaddr, int expected, int timeout_ms) {
+	struct futex_bucket *b;
+	struct futex_waiter w;
+	enum intr_level old_level;
+	int64_t until = INT64_MAX;
+	int *kaddr;
+
+	if (timeout_ms >= 0)
+		until = timer_ticks ()
+			+ DIV_ROUND_UP ((int64_t) timeout_ms * TIMER_FREQ, 1000);
+
+	kaddr = futex_key (uaddr, &b);
+	if (kaddr == NULL)
+		return -1;
+	/* Checked under the bucket lock, so futex_wake_process() can't
+	   miss us. */
+	if (*kaddr != expected || until <= timer_ticks ()
+			|| thread_current ()->proc->exiting) {
+		lock_release (&b->lock);
+		return -1;
+	}
+
+	w.key = kaddr;
+	w.thread = thread_current ();
+	w.blocked = w.woken = false;
+	list_push_back (&b->waiters, &w.elem);
+
+	/* Stay atomic with futex_wake() until we block: it only
+	   unblocks waiters that have. */
+	old_level = intr_disable ();
+	lock_release (&b->lock);
+	if (!w.woken) {
+		w.blocked = true;
+		thread_block_until (until);
+		w.blocked = false;
+	}
+	intr_set_level (old_level);
+
+	if (!w.woken) {
+		/* Timed out.  futex_wake() may have woken us since. */
+		lock_acquire (&b->lock);
+		if (!w.woken)
+			list_remove (&w.elem);
+		lock_release (&b->lock);
+	}
+	return w.woken ? 0 : -1;
+}
+
+/* Wakes up to CNT threads waiting on the futex at UADDR, highest
+   priority first.  Returns the number woken, or -1 if UADDR is not
+   a valid, aligned user address. */
+int
+futex_wake (int *uaddr, int cnt) {
+	struct futex_bucket *b;
+	enum intr_level old_level;
+	void *key;
+	int woken = 0;
+
+	key = futex_key (uaddr, &b);
+	if (key == NULL)
+		return -1;
+
+	while (woken < cnt) {
+		struct futex_waiter *best = NULL;
+		struct list_elem *e;
+
+		for (e = list_begin (&b->waiters); e != list_end (&b->waiters);
+				e = list_next (e)) {
+			struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+			if (w->key == key
+					&& (best == NULL || w->thread->priority > best->thread->priority))
+				best = w;
+		}
+		if (best == NULL)
+			break;
+
+		list_remove (&best->elem);
+		old_level = intr_disable ();
+		best->woken = true;
+		/* A waiter whose timeout just expired is ready already. */
+		if (best->blocked && best->thread->status == THREAD_BLOCKED)
+			thread_wake (best->thread);
+		intr_set_level (old_level);
+		woken++;
+	}
+	lock_release (&b->lock);
+
+	if (woken > 0 && preempt_by_priority ())
+		thread_yield ();
+	return woken;
+}
+
+/* Wakes every thread of PROC waiting on any futex, so that it can
+   notice that PROC is exiting. */
+void
+futex_wake_process (struct process *proc) {
+	enum intr_level old_level;
+
+	for (int i = 0; i < FUTEX_BUCKETS; i++) {
+		struct futex_bucket *b = &buckets[i];
+		struct list_elem *e;
+
+		lock_acquire (&b->lock);
+		for (e = list_begin (&b->waiters); e != list_end (&b->waiters); ) {
+			struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+			if (w->thread->proc != proc) {
+				e = list_next (e);
+				continue;
+			}
+			e = list_remove (e);
+			old_level = intr_disable ();
+			w->woken = true;
+			if (w->blocked && w->thread->status == THREAD_BLOCKED)
+				thread_wake (w->thread);
+			intr_set_level (old_level);
+		}
+		lock_release (&b->lock);
+	}
+}
+
+/* Returns the kernel address of the futex at user address UADDR,
+   faulting its page in if necessary, with its bucket locked and
+   stored in *BUCKET.  Returns a null pointer, with nothing locked,
+   if UADDR is not a valid, aligned user address. */
+static void *
+futex_key (int *uaddr, struct futex_bucket **bucket) {
+	struct thread *curr = thread_current ();
+
+	if (uaddr == NULL || !is_user_vaddr (uaddr)
+			|| (uintptr_t) uaddr % sizeof *uaddr != 0)
+		return NULL;
+
+	for (;;) {
+		int *kaddr;
+		struct futex_bucket *b;
+
+		/* Touch the page, then look up its frame.  If it was
+		   evicted before we locked the bucket, try again. */
+		(void) *(volatile int *) uaddr;
+		kaddr = pml4_get_page (curr->pml4, uaddr);
+		if (kaddr == NULL)
+			continue;
+
+		b = &buckets[hash_bytes (&kaddr, sizeof kaddr) % FUTEX_BUCKETS];
+		lock_acquire (&b->lock);
+		if (pml4_get_page (curr->pml4, uaddr) == kaddr) {
+			*bucket = b;
+			return kaddr;
+		}
+		lock_release (&b->lock);
+	}
+}
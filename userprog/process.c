@@ -13,10 +13,13 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
+#include "userprog/fpu.h"
+#include "userprog/futex.h"
 #include "intrinsic.h"
 #ifdef VM
 #include "vm/vm.h"
@@ -26,8 +29,39 @@ static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static struct process *process_alloc (void);
+static void process_free (struct process *);
+static void wait_other_threads (struct process *);
+static bool exec_single_thread (void);
+static void uthread_start (void *);
+static void uthread_exit (void);
+static bool setup_thread_stack (struct intr_frame *if_, int slot);
+
+#define MSR_FS_BASE 0xc0000100      /* FS segment base, the TLS pointer */
+
+/* Join record of a thread other than the leader.  It stays on its
+   process's `uthreads' until joined or the process goes away. */
+struct uthread {
+	tid_t tid;
+	int status;                 /* Exit status, once done. */
+	bool done;                  /* Has it exited? */
+	bool joined;                /* Someone in process_thread_join()? */
+	struct wait_queue join_wq;  /* Its joiner, waiting for it. */
+	struct list_elem elem;      /* Element in `uthreads'. */
+};
+
+/* Passed from process_thread_create() to the new thread. */
+struct uthread_start {
+	struct thread *creator;     /* Thread whose process to join. */
+	struct uthread *ut;         /* Join record to publish. */
+	void *entry;                /* User function to start at. */
+	void *arg;                  /* Its argument. */
+	void *tls;                  /* Initial FS base. */
+	int slot;                   /* User stack slot. */
+	struct semaphore started;   /* Upped once set up. */
+	bool success;               /* Set up successfully? */
+};
 
-static void argument_stack(struct intr_frame *if_, int argv_cnt, char **argv_list);
 
 /* General process initializer for initd and other process. */
 static void
@@ -74,8 +108,10 @@ process_create_initd (const char *file_name) {
 /* A thread function that launches first user process. */
 static void
 initd (void *f_name) {
+	if (process_alloc () == NULL)
+		PANIC("Fail to launch initd\n");
 #ifdef VM
-	supplemental_page_table_init (&thread_current ()->spt);
+	supplemental_page_table_init (&thread_current ()->proc->spt);
 #endif
 
 	// process_init ();
@@ -186,14 +222,19 @@ __do_fork (void *aux) {
 
 	/* ----------------------------- */
 	/* 2. Duplicate PT */
+	/* the child keeps running on the forking thread's stack and TLS */
+	current->ustack_slot = parent->ustack_slot;
+	current->fs_base = parent->fs_base;
 	current->pml4 = pml4_create();
-	if (current->pml4 == NULL)
+	if (current->pml4 == NULL || process_alloc () == NULL)
+		goto error;
+	if (!fpu_copy (current, parent))
 		goto error;
 
 	process_activate (current);
 #ifdef VM
-	supplemental_page_table_init (&current->spt);
-	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
+	supplemental_page_table_init (&current->proc->spt);
+	if (!supplemental_page_table_copy (&current->proc->spt, &parent->proc->spt))
 		goto error;
 #else	// vm space 여기서 복사
 	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
@@ -211,13 +252,20 @@ __do_fork (void *aux) {
 		goto error;
 	}
 
+	/* parent never opened a file: child gets its fd_table lazily too */
+	if (parent->fd_table != NULL) {
+		current->fd_table = thread_fdt_alloc();
+		if (current->fd_table == NULL)
+			goto error;
+	}
+
 	// Project2-extra) multiple fds sharing same file - use associative map (e.g. dict, hashmap) to duplicate these relationships
 	// other test-cases like multi-oom don't need this feature
 	const int MAPLEN = 10;
 	struct MapElem map[10]; // key - parent's struct file * , value - child's newly created struct file *
 	int dupCount = 0;		// index for filling map
 
-	for (int i = 0; i < FDCOUNT_LIMIT; i++){
+	for (int i = 0; parent->fd_table != NULL && i < FDCOUNT_LIMIT; i++){
 		struct file *file = parent->fd_table[i];
 		if(file == NULL)
 			continue;
@@ -290,6 +338,13 @@ process_exec (void *f_name) {
 	_if.cs = SEL_UCSEG; // stack - user code
 	_if.eflags = FLAG_IF | FLAG_MBS;
 
+	/* the other threads of the process don't survive exec */
+	if (!exec_single_thread ()) {
+		palloc_free_page (file_name);
+		return -1;
+	}
+	fpu_free (thread_current ());
+
 	/* We first kill the current context */
 	process_cleanup (); 
 	/* 새로운 실행 파일을 현재 쓰레드에 담기 전에 현재 프로세스에 담긴 컨텍스트를 지운다. 
@@ -318,7 +373,7 @@ process_exec (void *f_name) {
 	// -------------------------------------------------------------
 
 #ifdef VM
-	supplemental_page_table_init(&thread_current()->spt);
+	supplemental_page_table_init(&thread_current()->proc->spt);
 #endif
 
 	/* And then load the binary */
@@ -440,19 +495,42 @@ process_wait (tid_t child_tid UNUSED) {
 void
 process_exit (void) {
 	struct thread *curr = thread_current ();
+	struct process *proc = curr->proc;
 	/* TODO: Your code goes here.
 	 * TODO: Implement process termination message (see
 	 * TODO: project2/process_termination.html).
 	 * TODO: We recommend you to implement process resource cleanup here. */
 
-	for (int i = 0; i < FDCOUNT_LIMIT; i++) {
-		close(i);
+	fpu_free (curr);
+
+	/* a thread other than the leader only leaves the process */
+	if (proc != NULL && curr->tid != proc->pid) {
+		uthread_exit ();
+		return;
+	}
+
+	/* the leader takes the whole process down with it */
+	if (proc != NULL) {
+		process_set_exiting (curr->exit_status);
+		curr->exit_status = proc->exit_status;
+		wait_other_threads (proc);
+	}
+
+	if (curr->fd_table != NULL) {
+		for (int i = 0; i < FDCOUNT_LIMIT; i++) {
+			close(i);
+		}
+		thread_fdt_free(curr->fd_table);
+		curr->fd_table = NULL;
 	}
-	palloc_free_multiple(curr->fd_table, FDT_PAGES);
 
 	file_close(curr->running);
 
 	process_cleanup ();
+	if (proc != NULL) {
+		curr->proc = NULL;
+		process_free (proc);
+	}
 	
 	sema_up(&curr->wait_sema);
 	sema_down(&curr->free_sema);
@@ -465,8 +543,8 @@ process_cleanup (void) {
 	struct thread *curr = thread_current ();
 
 #ifdef VM
-	if(!hash_empty(&curr->spt.spt_hash)) {
-		supplemental_page_table_kill (&curr->spt);
+	if(curr->proc != NULL && !hash_empty(&curr->proc->spt.spt_hash)) {
+		supplemental_page_table_kill (&curr->proc->spt);
 	}
 #endif
 
@@ -492,11 +570,389 @@ process_cleanup (void) {
  * This function is called on every context switch. */
 void
 process_activate (struct thread *next) {
+	static uint64_t fs_base;
+
 	/* Activate thread's page tables. */
 	pml4_activate (next->pml4);
 
 	/* Set thread's kernel stack for use in processing interrupts. */
 	tss_update (next);
+
+	/* Make it trap on its first FPU use, unless its state is loaded. */
+	fpu_activate (next);
+
+	/* Load the user thread's TLS pointer.  Kernel threads don't use
+	 * FS, and wrmsr is slow, so only write it when it changes. */
+	if (next->proc != NULL && next->fs_base != fs_base) {
+		write_msr (MSR_FS_BASE, next->fs_base);
+		fs_base = next->fs_base;
+	}
+}
+
+/* Makes a process object for the current thread, which becomes the
+ * leader of a process of one thread.  Returns it, or a null pointer
+ * if out of memory. */
+static struct process *
+process_alloc (void) {
+	struct thread *curr = thread_current ();
+	struct process *proc = malloc (sizeof *proc);
+
+	if (proc == NULL)
+		return NULL;
+	proc->pid = curr->tid;
+	lock_init (&proc->lock);
+	wait_queue_init (&proc->leader_wq);
+	proc->thread_cnt = 1;
+	proc->exiting = false;
+	proc->exit_status = 0;
+	list_init (&proc->uthreads);
+	proc->stack_slots = 1u << curr->ustack_slot;
+	curr->proc = proc;
+	return proc;
+}
+
+/* Frees PROC and the join records nobody collected.  Its leader
+ * must be its last thread. */
+static void
+process_free (struct process *proc) {
+	ASSERT (proc->thread_cnt == 1);
+
+	while (!list_empty (&proc->uthreads))
+		free (list_entry (list_pop_front (&proc->uthreads),
+					struct uthread, elem));
+	free (proc);
+}
+
+/* Marks the current process as exiting with STATUS and kicks its
+ * other threads out of futex_wait() and process_thread_join(), so
+ * that each exits the next time it enters or leaves the kernel.
+ * Returns false if the process was already exiting, in which case
+ * the first STATUS stands. */
+bool
+process_set_exiting (int status) {
+	struct process *proc = thread_current ()->proc;
+	bool first, others;
+
+	if (proc == NULL)
+		return true;
+
+	lock_acquire (&proc->lock);
+	first = !proc->exiting;
+	others = proc->thread_cnt > 1;
+	if (first) {
+		struct list_elem *e;
+
+		proc->exiting = true;
+		proc->exit_status = status;
+		wake_up (&proc->leader_wq);
+		for (e = list_begin (&proc->uthreads); e != list_end (&proc->uthreads);
+				e = list_next (e))
+			wake_up (&list_entry (e, struct uthread, elem)->join_wq);
+	}
+	lock_release (&proc->lock);
+
+	if (first && others)
+		futex_wake_process (proc);
+	return first;
+}
+
+/* Terminates the calling thread if its process is exiting.  Called
+ * whenever a user thread enters or leaves the kernel. */
+void
+process_check_exiting (void) {
+	struct thread *curr = thread_current ();
+
+	if (curr->proc != NULL && curr->proc->exiting) {
+		intr_enable ();
+		curr->exit_status = curr->proc->exit_status;
+		thread_exit ();
+	}
+}
+
+/* Wait condition: AUX, a struct process, has only its leader left. */
+static bool
+process_single (void *aux) {
+	struct process *proc = aux;
+
+	return proc->thread_cnt == 1;
+}
+
+/* Wait condition: the same, or AUX is exiting. */
+static bool
+process_single_or_exiting (void *aux) {
+	struct process *proc = aux;
+
+	return proc->thread_cnt == 1 || proc->exiting;
+}
+
+/* Wait condition: AUX, a struct uthread, is done or its process,
+ * the current one, is exiting. */
+static bool
+uthread_done_or_exiting (void *aux) {
+	struct uthread *ut = aux;
+
+	return ut->done || thread_current ()->proc->exiting;
+}
+
+/* Waits until the caller, PROC's leader, is its only thread. */
+static void
+wait_other_threads (struct process *proc) {
+	lock_acquire (&proc->lock);
+	wait_event_lock (&proc->leader_wq, process_single, proc, &proc->lock);
+	lock_release (&proc->lock);
+}
+
+/* Before exec, terminates the other threads of the current process
+ * and forgets about them.  Fails if the caller is not the leader or
+ * the process is exiting anyway. */
+static bool
+exec_single_thread (void) {
+	struct thread *curr = thread_current ();
+	struct process *proc = curr->proc;
+
+	if (proc == NULL)
+		return true;
+	if (curr->tid != proc->pid || !process_set_exiting (-1))
+		return false;
+	wait_other_threads (proc);
+
+	lock_acquire (&proc->lock);
+	proc->exiting = false;
+	while (!list_empty (&proc->uthreads))
+		free (list_entry (list_pop_front (&proc->uthreads),
+					struct uthread, elem));
+	proc->stack_slots = 1;
+	lock_release (&proc->lock);
+
+	/* load() sets up the stack in slot 0 */
+	curr->ustack_slot = 0;
+	curr->fs_base = 0;
+	return true;
+}
+
+/* Returns the join record of thread TID in PROC, which must be
+ * locked, or a null pointer. */
+static struct uthread *
+uthread_find (struct process *proc, tid_t tid) {
+	struct list_elem *e;
+
+	for (e = list_begin (&proc->uthreads); e != list_end (&proc->uthreads);
+			e = list_next (e)) {
+		struct uthread *ut = list_entry (e, struct uthread, elem);
+		if (ut->tid == tid)
+			return ut;
+	}
+	return NULL;
+}
+
+/* Starts a new thread in the current process, running ENTRY (ARG)
+ * on a stack of its own with TLS as its FS base.  ENTRY must end by
+ * calling thread_exit() instead of returning.  Returns the new
+ * thread's tid, or TID_ERROR. */
+tid_t
+process_thread_create (void *entry, void *arg, void *tls) {
+	struct thread *curr = thread_current ();
+	struct process *proc = curr->proc;
+	struct uthread_start start;
+	tid_t tid;
+	int slot;
+
+	if (proc == NULL || entry == NULL || !is_user_vaddr (entry)
+			|| !is_user_vaddr (tls))
+		return TID_ERROR;
+
+	/* every thread must share one fd table, so it can't be lazy now */
+	if (curr->fd_table == NULL) {
+		curr->fd_table = thread_fdt_alloc ();
+		if (curr->fd_table == NULL)
+			return TID_ERROR;
+	}
+
+	start.ut = malloc (sizeof *start.ut);
+	if (start.ut == NULL)
+		return TID_ERROR;
+	start.ut->status = 0;
+	start.ut->done = start.ut->joined = false;
+	wait_queue_init (&start.ut->join_wq);
+
+	lock_acquire (&proc->lock);
+	for (slot = 0; slot < UTHREAD_MAX; slot++)
+		if ((proc->stack_slots & (1u << slot)) == 0)
+			break;
+	if (proc->exiting || slot == UTHREAD_MAX) {
+		lock_release (&proc->lock);
+		free (start.ut);
+		return TID_ERROR;
+	}
+	proc->stack_slots |= 1u << slot;
+	proc->thread_cnt++;
+	lock_release (&proc->lock);
+
+	start.creator = curr;
+	start.entry = entry;
+	start.arg = arg;
+	start.tls = tls;
+	start.slot = slot;
+	start.success = false;
+	sema_init_named (&start.started, 0, NULL);
+
+	tid = thread_create (curr->name, curr->initial_priority, uthread_start,
+			&start);
+	if (tid == TID_ERROR) {
+		lock_acquire (&proc->lock);
+		proc->stack_slots &= ~(1u << slot);
+		proc->thread_cnt--;
+		lock_release (&proc->lock);
+	} else {
+		/* on failure the new thread leaves the process by itself */
+		sema_down (&start.started);
+		if (!start.success)
+			tid = TID_ERROR;
+	}
+	if (tid == TID_ERROR)
+		free (start.ut);
+	return tid;
+}
+
+/* A thread function that enters a new thread of the creator's
+ * process in user mode. */
+static void
+uthread_start (void *aux) {
+	struct uthread_start *start = aux;
+	struct thread *creator = start->creator;
+	struct thread *curr = thread_current ();
+	struct process *proc = creator->proc;
+	struct intr_frame if_;
+	bool success;
+
+	/* not a child of the creator: nobody waits for it with wait() */
+	list_remove (&curr->child_elem);
+
+	curr->proc = proc;
+	curr->pml4 = creator->pml4;
+	curr->fd_table = creator->fd_table;
+	curr->fd_idx = creator->fd_idx;
+	curr->ustack_slot = start->slot;
+	curr->fs_base = (uint64_t) start->tls;
+	process_activate (curr);
+
+	memset (&if_, 0, sizeof if_);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+	if_.rip = (uintptr_t) start->entry;
+	if_.R.rdi = (uint64_t) start->arg;
+
+	success = start->success = setup_thread_stack (&if_, start->slot);
+	if (success) {
+		start->ut->tid = curr->tid;
+		lock_acquire (&proc->lock);
+		list_push_back (&proc->uthreads, &start->ut->elem);
+		lock_release (&proc->lock);
+	}
+	sema_up (&start->started);
+	/* START is gone now. */
+
+	if (!success) {
+		curr->exit_status = TID_ERROR;
+		thread_exit ();
+	}
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* Waits for thread TID of the current process to exit and returns
+ * its exit status.  Returns -1 at once if TID is not a thread of the
+ * process other than its leader, has been joined already, or if the
+ * process is exiting. */
+int
+process_thread_join (tid_t tid) {
+	struct thread *curr = thread_current ();
+	struct process *proc = curr->proc;
+	struct uthread *ut;
+	int status = -1;
+
+	if (proc == NULL)
+		return -1;
+
+	lock_acquire (&proc->lock);
+	ut = uthread_find (proc, tid);
+	if (ut != NULL && !ut->joined && tid != curr->tid) {
+		ut->joined = true;
+		wait_event_lock (&ut->join_wq, uthread_done_or_exiting, ut,
+				&proc->lock);
+		if (ut->done) {
+			status = ut->status;
+			list_remove (&ut->elem);
+			free (ut);
+		} else
+			ut->joined = false;
+	}
+	lock_release (&proc->lock);
+	return status;
+}
+
+/* Terminates the calling thread with STATUS, for
+ * process_thread_join().  The leader stands for the process, so it
+ * first waits for the other threads and then exits the process. */
+void
+process_thread_exit (int status) {
+	struct thread *curr = thread_current ();
+	struct process *proc = curr->proc;
+
+	if (proc != NULL && curr->tid == proc->pid) {
+		lock_acquire (&proc->lock);
+		wait_event_lock (&proc->leader_wq, process_single_or_exiting, proc,
+				&proc->lock);
+		lock_release (&proc->lock);
+		exit (status);
+	}
+	curr->exit_status = status;
+	thread_exit ();
+}
+
+/* Called by process_exit() for a thread other than the leader:
+ * reports its exit status to process_thread_join() and leaves the
+ * process, whose address space and files stay with the others. */
+static void
+uthread_exit (void) {
+	struct thread *curr = thread_current ();
+	struct process *proc = curr->proc;
+	struct uthread *ut;
+
+	/* The leader may tear the address space down once we're gone,
+	 * so stop using it first.  The stack pages stay mapped for the
+	 * next thread in the slot, and are freed with the process. */
+	curr->pml4 = NULL;
+	curr->fd_table = NULL;
+	pml4_activate (NULL);
+
+	lock_acquire (&proc->lock);
+	ut = uthread_find (proc, curr->tid);
+	if (ut != NULL) {
+		ut->status = curr->exit_status;
+		ut->done = true;
+		wake_up (&ut->join_wq);
+	}
+	proc->stack_slots &= ~(1u << curr->ustack_slot);
+	/* Only the leader cares, and only about the last one. */
+	if (--proc->thread_cnt == 1)
+		wake_up (&proc->leader_wq);
+	lock_release (&proc->lock);
+	curr->proc = NULL;
+}
+
+/* Returns true if user address UADDR lies in the stack slot of a
+ * live thread of the current process, where its stack may grow. */
+bool
+process_stack_contains (const void *uaddr) {
+	struct process *proc = thread_current ()->proc;
+	uint64_t addr = (uint64_t) uaddr;
+
+	if (proc == NULL || addr >= USER_STACK
+			|| addr < USER_STACK - (uint64_t) UTHREAD_MAX * USTACK_SIZE)
+		return false;
+	return (proc->stack_slots & (1u << ((USER_STACK - 1 - addr) / USTACK_SIZE))) != 0;
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -572,18 +1028,6 @@ load (const char *file_name, struct intr_frame *if_) {
 	int i;
 
 
-	/* ---------project2 -----------*/
-	// char *file_name_copy[48];
-	char *argv_list[64];
-	char *token, *save_ptr;
-	int argv_cnt = 0;
-	
-	for (token = strtok_r (file_name, " ", &save_ptr); token != NULL; token = strtok_r (NULL, " ", &save_ptr)){
-   		argv_list[argv_cnt] = token;
-		argv_cnt++;
-	}
-	/* ---------------------------- */
-
 	/* Allocate and activate page directory. */
 	t->pml4 = pml4_create (); /* 페이지 디렉토리 생성 */
 	if (t->pml4 == NULL)
@@ -676,11 +1120,7 @@ load (const char *file_name, struct intr_frame *if_) {
 	/* TODO: Your code goes here. 파일 네임 파싱시키기
 	 * TODO: Implement argument passing (see project2/argument_passing.html). */
 
-	/* ----------- project2 ---------- */
-	
-	argument_stack(if_, argv_cnt, argv_list);	
-		
-	/*---------------------------------*/
+	/* 인자는 load 가 끝난 뒤 process_exec 에서 argument_stack () 으로 쌓는다. */
 
 	success = true;
 
@@ -690,40 +1130,6 @@ done:
 	return success;
 }
 
-static void argument_stack(struct intr_frame *if_, int argv_cnt, char **argv_list) {
-	int i;
-	// char *argu_addr[128];
-	int argc_len;
-
-	for (i = argv_cnt-1; i >= 0; i--){
-		argc_len = strlen(argv_list[i]);
-		if_->rsp = if_->rsp - (argc_len+1); 
-		memcpy(if_->rsp, argv_list[i], (argc_len+1));
-		argv_list[i] = if_->rsp;
-	}
-
-	while (if_->rsp%8 != 0){
-		if_->rsp--;
-		memset(if_->rsp, 0, sizeof(uint8_t));
-	}
-
-	for (i = argv_cnt; i>=0; i--){
-		if_->rsp = if_->rsp - 8;
-		if (i == argv_cnt){
-			memset(if_->rsp, 0, sizeof(char **));
-		}else{
-			memcpy(if_->rsp, &argv_list[i] , sizeof(char **));
-		}
-	}
-
-	if_->rsp = if_->rsp - 8;
-	memset(if_->rsp, 0, sizeof(void *));
-
-	if_->R.rdi = argv_cnt;
-	if_->R.rsi = if_->rsp + 8;	
-
-}
-
 /* Checks whether PHDR describes a valid, loadable segment in
  * FILE and returns true if so, false otherwise. */
 static bool
@@ -849,6 +1255,28 @@ setup_stack (struct intr_frame *if_) {
 	return success;
 }
 
+/* Like setup_stack(), but for a new thread in stack slot SLOT.  A
+ * page left behind by the slot's previous thread is reused.  Points
+ * rsp at a null return address, as if ENTRY had been called. */
+static bool
+setup_thread_stack (struct intr_frame *if_, int slot) {
+	uint8_t *stack_top = (uint8_t *) USER_STACK - (size_t) slot * USTACK_SIZE;
+	uint8_t *kpage;
+
+	if (pml4_get_page (thread_current ()->pml4, stack_top - PGSIZE) == NULL) {
+		kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+		if (kpage == NULL)
+			return false;
+		if (!install_page (stack_top - PGSIZE, kpage, true)) {
+			palloc_free_page (kpage);
+			return false;
+		}
+	}
+	if_->rsp = (uintptr_t) stack_top - sizeof (void *);
+	*(void **) if_->rsp = NULL;
+	return true;
+}
+
 /* Adds a mapping from user virtual address UPAGE to kernel
  * virtual address KPAGE to the page table.
  * If WRITABLE is true, the user process may modify the page;
@@ -859,7 +1287,7 @@ setup_stack (struct intr_frame *if_) {
  * Returns true on success, false if UPAGE is already mapped or
  * if memory allocation fails. */
 static bool
-ㄷinstall_page (void *upage, void *kpage, bool writable) {
+install_page (void *upage, void *kpage, bool writable) {
 	struct thread *t = thread_current ();
 
 	/* Verify that there's not already a page at that virtual
@@ -1016,7 +1444,7 @@ setup_stack(struct intr_frame *if_)
 		if_->rsp = USER_STACK; //setting rsp
 
 		#ifdef DEBUG_VM
-		struct supplemental_page_table *spt = &thread_current ()->spt;
+		struct supplemental_page_table *spt = &thread_current ()->proc->spt;
 		struct page * stack_bottom_page = spt_find_page (spt, stack_bottom);
 		printf("First stack page - %p\n\n", stack_bottom_page->va);
 		#endif
@@ -1027,6 +1455,23 @@ setup_stack(struct intr_frame *if_)
 
 	return success;
 }
+
+/* Like setup_stack(), but for a new thread in stack slot SLOT.  A
+ * page left behind by the slot's previous thread is reused.  Points
+ * rsp at a null return address, as if ENTRY had been called. */
+static bool
+setup_thread_stack (struct intr_frame *if_, int slot) {
+	uint8_t *stack_top = (uint8_t *) USER_STACK - (size_t) slot * USTACK_SIZE;
+	void *stack_bottom = stack_top - PGSIZE;
+
+	if (spt_find_page (&thread_current ()->proc->spt, stack_bottom) == NULL
+			&& !(vm_alloc_page (VM_ANON | VM_MARKER_0, stack_bottom, true)
+				&& vm_claim_page (stack_bottom)))
+		return false;
+	if_->rsp = (uintptr_t) stack_top - sizeof (void *);
+	*(void **) if_->rsp = NULL;
+	return true;
+}
 #endif /* VM */
 
 struct thread *get_child_with_pid(int pid)
@@ -5,6 +5,7 @@
 #include "threads/thread.h"
 #include "threads/loader.h"
 #include "userprog/gdt.h"
+#include "userprog/futex.h"
 #include "threads/flags.h"
 #include "intrinsic.h" 
 /* ---------- Project 2 ---------- */
@@ -17,6 +18,7 @@
 #include "vm/vm.h"
 #include <list.h>
 #include "threads/vaddr.h"
+#include "threads/mmu.h"
 
 // P2_3 추가 */ 
 #include "filesys/filesys.h"
@@ -89,6 +91,7 @@ syscall_init (void) {
 	/* ---------- Project 2 ---------- */
 	lock_init(&filesys_lock);
 	/* ------------------------------- */
+	futex_init ();
 }
 
 /* The main system call interface */
@@ -105,6 +108,9 @@ syscall_handler (struct intr_frame *f UNUSED) {
 	// printf ("system call! rax : %d\n", f->R.rax);
 	// thread_exit ();
 
+	/* threads of an exiting process go no further */
+	process_check_exiting ();
+
 	/* ---------- Project 2 ---------- */
 	switch(f->R.rax) {
 		case SYS_HALT:
@@ -152,17 +158,40 @@ syscall_handler (struct intr_frame *f UNUSED) {
 		case SYS_CLOSE:
 			close(f->R.rdi);
 			break;
+#ifdef VM
 		case SYS_MMAP:
 			f->R.rax = mmap(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10, f->R.r8);
 			break;
 		case SYS_MUNMAP:
 			munmap(f->R.rdi);
 			break;
+#endif
+		case SYS_SCHED_SETSCHEDULER:
+			f->R.rax = thread_set_policy(f->R.rdi, f->R.rsi) ? 0 : -1;
+			break;
+		case SYS_FUTEX_WAIT:
+			f->R.rax = futex_wait(f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_FUTEX_WAKE:
+			f->R.rax = futex_wake(f->R.rdi, f->R.rsi);
+			break;
+		case SYS_THREAD_CREATE:
+			f->R.rax = process_thread_create(f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_THREAD_JOIN:
+			f->R.rax = process_thread_join(f->R.rdi);
+			break;
+		case SYS_THREAD_EXIT:
+			process_thread_exit(f->R.rdi);
+			break;
 		default:
 			exit(-1);
 			break;
 	}
 	/* ------------------------------- */
+
+	/* e.g. another thread called exit() while we slept */
+	process_check_exiting ();
 }
 
 /* ---------- Project 2 구현, P3 수정 추가 ---------- */
@@ -186,9 +215,31 @@ struct page * check_address(void * addr) {
 		exit(-1);
 	}
 
-	return spt_find_page(&thread_current()->spt, addr);
+#ifdef VM
+	return spt_find_page(&thread_current()->proc->spt, addr);
+#else
+	/* spt 가 없으므로 page table 에 매핑만 확인한다. */
+	if (pml4_get_page (thread_current ()->pml4, addr) == NULL)
+		exit(-1);
+	return NULL;
+#endif
 }
 
+#ifndef VM
+void check_valid_buffer(void *buffer, unsigned size, void *rsp UNUSED, bool to_write) {
+	struct thread *curr = thread_current ();
+
+	for (unsigned i = 0; i < size; i++) {
+		void *addr = buffer + i;
+		check_address(addr);
+
+		/* 유저 버퍼에 써야 하는데 읽기 전용 페이지인 경우 */
+		uint64_t *pte = pml4e_walk (curr->pml4, (uint64_t) addr, 0);
+		if (to_write && (pte == NULL || !is_writable (pte)))
+			exit(-1);
+	}
+}
+#else
 void check_valid_buffer(void *buffer, unsigned size, void *rsp, bool to_write) {
 	for (int i = 0; i < size; i++) {
 		struct page* page = check_address(buffer + i);
@@ -204,19 +255,7 @@ void check_valid_buffer(void *buffer, unsigned size, void *rsp, bool to_write) {
 		}
 	}
 }
-
-// Project 2-4. File descriptor
-// Check if given fd is valid, return cur->fdTable[fd]
-static struct file *find_file_by_fd(int fd)
-{
-	struct thread *cur = thread_current();
-
-	// Error - invalid fd
-	if (fd < 0 || fd >= FDCOUNT_LIMIT)
-		return NULL;
-
-	return cur->fd_table[fd]; // automatically returns NULL if empty
-}
+#endif
 
 /* Check validity of given file descriptor in current thread fd_table */
 static struct file *
@@ -227,16 +266,32 @@ get_file_from_fd_table(int fd) {
 		return NULL;
 	}
 
+	/* no file opened yet, so there is no fd_table: only the dummy STDIN and STDOUT */
+	if (curr->fd_table == NULL) {
+		if (fd == STDIN)
+			return (struct file *) 1;
+		if (fd == STDOUT)
+			return (struct file *) 2;
+		return NULL;
+	}
+
 	return curr->fd_table[fd];	/*return fd of current thread. if fd_table[fd] == NULL, it automatically returns NULL*/
 }
 
+// Project 2-4. File descriptor
+// Check if given fd is valid, return cur->fdTable[fd]
+static struct file *find_file_by_fd(int fd)
+{
+	return get_file_from_fd_table(fd);
+}
+
 /* Remove give fd from current thread fd_table */
 void
 remove_file_from_fdt(int fd)
 {
 	struct thread *cur = thread_current();
 
-	if (fd < 0 || fd >= FDCOUNT_LIMIT) /* Error - invalid fd */
+	if (fd < 0 || fd >= FDCOUNT_LIMIT || cur->fd_table == NULL) /* Error - invalid fd */
 		return;
 
 	cur->fd_table[fd] = NULL;
@@ -248,6 +303,13 @@ add_file_to_fdt(struct file *file) {
 	struct thread *curr = thread_current();
 	struct file **fdt = curr->fd_table;
 
+	/* allocate fd_table on first open */
+	if (fdt == NULL) {
+		fdt = curr->fd_table = thread_fdt_alloc();
+		if (fdt == NULL)
+			return -1;
+	}
+
 	while (curr->fd_idx < FDCOUNT_LIMIT && fdt[curr->fd_idx]) {
 		curr->fd_idx++;
 	}
@@ -269,7 +331,9 @@ void exit(int status) {
 	struct thread *curr = thread_current();
 	curr->exit_status = status;
 
-	printf("%s: exit(%d)\n", thread_name(), status);
+	/* only the first thread to exit its process reports it */
+	if (process_set_exiting(status))
+		printf("%s: exit(%d)\n", thread_name(), status);
 	
 	thread_exit();
 }
@@ -468,6 +532,7 @@ close (int fd) {
 
 /* ------------------------------- */
 
+#ifdef VM
 // Project 3-3 mmap
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset){
 	// Fail : map to i/o console, zero length, map at 0, addr not page-aligned
@@ -487,4 +552,5 @@ void *mmap (void *addr, size_t length, int writable, int fd, off_t offset){
 // Project 3-3 mmap
 void munmap (void *addr){
 	do_munmap(addr);
-}
\ No newline at end of file
+}
+#endif
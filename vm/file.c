@@ -1,6 +1,7 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "userprog/process.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
@@ -116,12 +117,12 @@ lazy_load_segment_for_file(struct page *page, void *aux)
 	if (file_read(file, kva, page_read_bytes) != (int)page_read_bytes)
 	{
 		//palloc_free_page(page); // #ifdef DBG Q. 여기서 free해주는거 맞아?
-		free(lazy_load_info);
+		lazy_load_info_free (lazy_load_info);
 		return false;
 	}
 
 	memset(kva + page_read_bytes, 0, page_zero_bytes);
-	free(lazy_load_info);
+	lazy_load_info_free (lazy_load_info);
 
 	file_seek(file, offset); // may read the file later - reset fileobj pos
 
@@ -152,17 +153,17 @@ do_mmap (void *addr, size_t length, int writable,
 	// throw off data that sticks out 
 	while(length > 0){
 		// Fail : pages mapped overlaps other existing pages or kernel memory
-		if(spt_find_page(&t->spt, addr) != NULL || is_kernel_vaddr(addr)){
+		if(spt_find_page(&t->proc->spt, addr) != NULL || is_kernel_vaddr(addr)){
 			void *free_addr = start_addr; // get page from this user vaddr and destroy them
 			while(free_addr < addr){
 				// free allocated uninit page
-				page = spt_find_page(&t->spt, free_addr);
+				page = spt_find_page(&t->proc->spt, free_addr);
 
 				// destroy(page); // uninit destroy - free aux
 				// free(page->frame);
 				// free(page);
 				// remove_page(page);
-				spt_remove_page(&t->spt, page);
+				spt_remove_page(&t->proc->spt, page);
 
 
 				free_addr += PGSIZE;
@@ -178,7 +179,7 @@ do_mmap (void *addr, size_t length, int writable,
 		#endif
 
 		// file info to load onto memory once fault occurs
-		struct lazy_load_info *lazy_load_info = malloc(sizeof(struct lazy_load_info));
+		struct lazy_load_info *lazy_load_info = lazy_load_info_alloc ();
 		lazy_load_info->file = file_reopen(file); // mmap-close - closing file after mmap
 		lazy_load_info->page_read_bytes = page_read_bytes;
 		lazy_load_info->page_zero_bytes = page_zero_bytes;
@@ -189,7 +190,7 @@ do_mmap (void *addr, size_t length, int writable,
 			return NULL;
 
 		// record page_cnt
-		page = spt_find_page(&t->spt, addr);
+		page = spt_find_page(&t->proc->spt, addr);
 		page->page_cnt = page_cnt;
 
 		offset += page_read_bytes;
@@ -243,7 +244,7 @@ do_munmap (void *addr) {
 	struct thread *t = thread_current();
 	struct page *page;
 
-	page = spt_find_page(&t->spt, addr);
+	page = spt_find_page(&t->proc->spt, addr);
 	//int prev_cnt = 0;
 	int prev_cnt = page->page_cnt - 1; //if the file size is bigger than memmory space, first page of consecutive file-pages in memory is not the first page of the file.
 
@@ -271,9 +272,9 @@ do_munmap (void *addr) {
 		// free(page->frame);
 		// free(page);
 		//remove_page(page);
-		// spt_remove_page(&t->spt, page);
+		// spt_remove_page(&t->proc->spt, page);
 
 		addr += PGSIZE;
-		page = spt_find_page(&t->spt, addr);
+		page = spt_find_page(&t->proc->spt, addr);
 	}
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "userprog/process.h"
 /* P3 추가 */
 bool delete_page (struct hash *pages, struct page *p);
 unsigned page_hash(const struct hash_elem *p_, void *aux UNUSED);
@@ -12,6 +15,11 @@ void hash_action_copy (struct hash_elem *e, void *hash_aux);
 void hash_action_destroy (struct hash_elem *e, void *aux);
 static void vm_stack_growth (void *addr UNUSED);
 
+/* Caches of the objects made on every fault and mmap. */
+static struct kmem_cache *page_cache;
+static struct kmem_cache *frame_cache;
+static struct kmem_cache *lazy_load_info_cache;
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -25,6 +33,23 @@ vm_init (void) {
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
 	list_init(&frame_table);
+	page_cache = kmem_cache_create ("page", sizeof (struct page), NULL);
+	frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+	lazy_load_info_cache = kmem_cache_create ("lazy_load_info",
+			sizeof (struct lazy_load_info), NULL);
+}
+
+/* Allocates a struct lazy_load_info.  Returns a null pointer if
+ * memory is not available. */
+struct lazy_load_info *
+lazy_load_info_alloc (void) {
+	return kmem_cache_alloc (lazy_load_info_cache);
+}
+
+/* Frees INFO, from lazy_load_info_alloc(). */
+void
+lazy_load_info_free (struct lazy_load_info *info) {
+	kmem_cache_free (lazy_load_info_cache, info);
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -54,7 +79,7 @@ static struct frame *vm_evict_frame (void);
 
 bool vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, vm_initializer *init, void *aux) {
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
-	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
@@ -72,7 +97,7 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writab
 				break;
 		}
 
-		struct page *new_page = malloc(sizeof(struct page));
+		struct page *new_page = kmem_cache_alloc (page_cache);
 		uninit_new (new_page, upage, init, type, aux, initializer);
 
 		new_page->writable = writable;
@@ -163,18 +188,22 @@ vm_evict_frame (void) {
 	If there is no available page, evict the page and return it. 
 	This always return valid address. 
 	That is, if the user pool memory is full, 
-	this function evicts the frame to get the available memory space.*/
-static struct frame *vm_get_frame (void) {
+	this function evicts the frame to get the available memory space.
+	If ZERO is true, the frame is filled with zeros, preferably by
+	taking a page from palloc's zero pool.*/
+static struct frame *vm_get_frame (bool zero) {
 	struct frame *frame = NULL;
-	void *kva = palloc_get_page(PAL_USER);
+	void *kva = palloc_get_page(PAL_USER | (zero ? PAL_ZERO : 0));
 	/* TODO: Fill this function. */
 
 	/* P3 추가 */
 	if (kva == NULL){ // NULL이면(사용 가능한 페이지가 없으면) 
 		frame = vm_evict_frame(); // 페이지 삭제 후 frame 리턴
+		if (zero)
+			memset (frame->kva, 0, PGSIZE);
 	}
 	else{ // 사용 가능한 페이지가 있으면
-		frame = malloc(sizeof(struct frame)); // 페이지 사이즈만큼 메모리 할당
+		frame = kmem_cache_alloc (frame_cache); // frame 구조체 할당
 		frame->kva = kva;
 	}
 	
@@ -198,8 +227,13 @@ vm_handle_wp (struct page *page UNUSED) {
 bool
 vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
+	struct supplemental_page_table *spt UNUSED;
 	struct page *page = NULL;
+
+	/* Kernel threads have no user address space. */
+	if (thread_current ()->proc == NULL)
+		return false;
+	spt = &thread_current ()->proc->spt;
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
 
@@ -218,10 +252,9 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	else if (fpage == NULL){
 		void *rsp = user ? f->rsp : thread_current()->rsp; // a page fault occurs in the kernel
 		const int GROWTH_LIMIT = 32; // heuristic
-		const int STACK_LIMIT = USER_STACK - (1<<20); // 1MB size limit on stack
 
-		// Check stack size max limit and stack growth request heuristically
-		if((uint64_t)addr > STACK_LIMIT && USER_STACK > (uint64_t)addr && (uint64_t)addr > (uint64_t)rsp - GROWTH_LIMIT){
+		// Check stack size max limit (each thread's stack slot) and stack growth request heuristically
+		if(process_stack_contains(addr) && (uint64_t)addr > (uint64_t)rsp - GROWTH_LIMIT){
 			vm_stack_growth (fpage_uvaddr);
 			fpage = spt_find_page(spt, fpage_uvaddr);
 		}
@@ -251,7 +284,7 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 void
 vm_dealloc_page (struct page *page) {
 	destroy (page);
-	free (page);
+	kmem_cache_free (page_cache, page);
 }
 
 /* Claim the page that allocate on VA. */
@@ -268,7 +301,7 @@ vm_claim_page (void *va UNUSED) {
 	// 여기서 할당 준비해서 do_claim으로 보내서 페이지테이블에 맵핑
 	// 이 주제의 목적인 supplemental_page_table에서 찾기 구현을 여기서 하면 됨!!
 	ASSERT(is_user_vaddr(va)) // 체크용
-	struct supplemental_page_table *spt = &thread_current()->spt; // 이러면 주소를 가리키는건가?
+	struct supplemental_page_table *spt = &thread_current()->proc->spt; // 이러면 주소를 가리키는건가?
 	struct page *page = spt_find_page(spt, va);
 	if (page == NULL) {
 		return false;
@@ -280,7 +313,12 @@ vm_claim_page (void *va UNUSED) {
 /* va에서 PT(안의 pa)에 매핑을 추가함. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	/* An anonymous page with nothing to load, such as a stack page,
+	   starts out as zeros. */
+	bool zero = page->operations->type == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& page->uninit.init == NULL;
+	struct frame *frame = vm_get_frame (zero);
 	/* P3 추가 */
 
 	/* Set links */
@@ -346,7 +384,7 @@ bool page_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux
 /* P3 추가 */
 void hash_action_copy (struct hash_elem *e, void *hash_aux) {
 	struct thread *t = thread_current();
-	ASSERT(&t->spt == (struct supplemental_page_table *)hash_aux); //child's SPT
+	ASSERT(&t->proc->spt == (struct supplemental_page_table *)hash_aux); //child's SPT
 
 	struct page *page = hash_entry(e, struct page, hash_elem);
 	enum vm_type type = page->operations->type; // type of page to copy
@@ -357,7 +395,7 @@ void hash_action_copy (struct hash_elem *e, void *hash_aux) {
 		void *aux = uninit->aux;
 
 		// copy aux (struct lazy_load_info *)
-		struct lazy_load_info *lazy_load_info = malloc(sizeof(struct lazy_load_info));
+		struct lazy_load_info *lazy_load_info = lazy_load_info_alloc ();
 		if(lazy_load_info == NULL) {
 			// #ifdef DBG
 			// malloc fail - kernel pool all used
@@ -370,7 +408,7 @@ void hash_action_copy (struct hash_elem *e, void *hash_aux) {
 
 		// uninit page created by mmap - record page_cnt
 		if(uninit->type == VM_FILE) {
-			struct page *newpage = spt_find_page(&t->spt, page->va);
+			struct page *newpage = spt_find_page(&t->proc->spt, page->va);
 			newpage->page_cnt = page->page_cnt;
 		}
 	}
@@ -378,14 +416,14 @@ void hash_action_copy (struct hash_elem *e, void *hash_aux) {
 		// when __do_fork is called, thread_current is the child thread so we can just use vm_alloc_page
 		vm_alloc_page(type, page->va, page->writable);
 
-		struct page *newpage = spt_find_page(&t->spt, page->va); // copied page
+		struct page *newpage = spt_find_page(&t->proc->spt, page->va); // copied page
 		vm_do_claim_page(newpage);
 
 		ASSERT(page->frame != NULL);
 		memcpy(newpage->frame->kva, page->frame->kva, PGSIZE);
 	}
 	if(type == VM_FILE) {
-		struct lazy_load_info *lazy_load_info = malloc(sizeof(struct lazy_load_info));
+		struct lazy_load_info *lazy_load_info = lazy_load_info_alloc ();
 
 		struct file_page *file_page = &page->file;
 		lazy_load_info->file = file_reopen(file_page->file);
@@ -395,7 +433,7 @@ void hash_action_copy (struct hash_elem *e, void *hash_aux) {
 		void *aux = lazy_load_info;
 		vm_alloc_page_with_initializer(type, page->va, page->writable, lazy_load_segment_for_file, aux);
 
-		struct page *newpage = spt_find_page(&t->spt, page->va); // copied page
+		struct page *newpage = spt_find_page(&t->proc->spt, page->va); // copied page
 		vm_do_claim_page(newpage);
 
 		newpage->page_cnt = page->page_cnt;